@@ -27,6 +27,12 @@ LOCAL_SRC_FILES := \
         $(LOCAL_PATH)/dii_media_utils.cc \
         $(LOCAL_PATH)/dii_player.cc \
         $(LOCAL_PATH)/dii_audio_manager.cc \
+        $(LOCAL_PATH)/dii_worker_pool.cc \
+        $(LOCAL_PATH)/dii_http_cache.cc \
+        $(LOCAL_PATH)/dii_thumbnail.cc \
+        $(LOCAL_PATH)/dii_keyframe_index.cc \
+        $(LOCAL_PATH)/dii_memory_budget.cc \
+        $(LOCAL_PATH)/dii_timer_wheel.cc \
         $(LOCAL_PATH)/dii_audio_mixer_io.cc \
         $(LOCAL_PATH)/dii_rtmp/dii_rtmp_player.cc \
         $(LOCAL_PATH)/dii_rtmp/dii_rtmp_puller.cc \
@@ -28,17 +28,19 @@ namespace dii_media_kit {
     AudioMixer::Source::AudioFrameInfo DiiAudioSource::GetAudioFrameWithInfo(int sample_rate_hz, AudioFrame* audio_frame) {
         int readed_bytes = 0;
         if (audio_tracker_ != NULL) {
-                int16_t buffer[2000] = {0};
-                readed_bytes = audio_tracker_->OnNeedPlayAudio(buffer,  sample_rate_, channel_nb_);
-                audio_frame->UpdateFrame(frame_id_++,
-                                         (int32_t)DiiUnixTimestampMs(),
-                                         buffer,
-                                         sample_rate_/100,
-                                         sample_rate_,
-                                         AudioFrame::SpeechType::kNormalSpeech,
-                                         AudioFrame::VADActivity::kVadUnknown,
-										 channel_nb_);
-               
+                // pull straight into frame, no intermediate copy
+                size_t samples = sample_rate_ / 100 * channel_nb_;
+                readed_bytes = audio_tracker_->OnNeedPlayAudio(audio_frame->data_,  sample_rate_, channel_nb_);
+                if (readed_bytes <= 0) {
+                    memset(audio_frame->data_, 0, samples * sizeof(int16_t));
+                }
+                audio_frame->id_ = frame_id_++;
+                audio_frame->timestamp_ = (int32_t)DiiUnixTimestampMs();
+                audio_frame->samples_per_channel_ = sample_rate_ / 100;
+                audio_frame->sample_rate_hz_ = sample_rate_;
+                audio_frame->speech_type_ = AudioFrame::SpeechType::kNormalSpeech;
+                audio_frame->vad_activity_ = AudioFrame::VADActivity::kVadUnknown;
+                audio_frame->num_channels_ = channel_nb_;
             }
             
             return AudioMixer::Source::AudioFrameInfo::kNormal;
@@ -116,6 +116,13 @@ namespace dii_media_kit {
         int32_t video_height_;
         int32_t video_decode_framerate;
         int32_t video_render_framerate;
+        int32_t video_late_dropped_frames_; // total frames dropped for decode late to audio clock
+        int32_t video_decode_headroom_;     // percent of decode thread idle time
+        int32_t video_decode_quality_;      // 0: full, 1: skip loop filter, 2: + skip idct of non-ref, 3: + lowres
+        int32_t video_decode_quality_changes_; // times of decode quality step since start
+        int32_t video_convert_time_us_;     // average cost (us) per frame to scale / convert for video_frame_callback
+        int32_t video_delivery_dropped_frames_; // async delivery, frames dropped as app callback is behind
+        int32_t video_delivery_late_frames_;    // async delivery, frames waited over 50ms in queue
 
         // audio
         int32_t audio_samplerate_ = 0;
@@ -127,8 +134,19 @@ namespace dii_media_kit {
         
         int64_t sync_ts_;
 
+        // memory, bytes cached by this player / all players
+        int64_t memory_bytes_;
+        int64_t memory_total_bytes_;
+        int32_t memory_pressure_;   // 0: normal, 1: drop non-ref video, 2: shrink cache, 3: pause read
+        int32_t memory_dropped_frames_; // non-ref video frames dropped by memory pressure
+
+        int32_t buffering_count_;   // times of buffering (stall) since start
 
 		int64_t start_to_render_time_;
+        // startup cost (ms) of file / vod: open input, find stream info, first frame rendered
+        int32_t open_time_;
+        int32_t probe_time_;
+        int32_t first_frame_time_;
         // 流畅度
         DiiFluency fluency;
         
@@ -139,7 +157,9 @@ namespace dii_media_kit {
 
     enum DiiVideoFrameType {
         TYPE_YUV420 = 0,  // YUV 420 format
-        TYPE_RGBA32 = 1,  // RGBA 8888 format
+        TYPE_RGBA32 = 1,  // RGBA 8888 format, byte order R G B A
+        TYPE_NV12   = 2,  // NV12 format, y_buffer and interleaved UV in u_buffer / u_stride
+        TYPE_BGRA32 = 3,  // BGRA 8888 format, byte order B G R A, in rgba_buffer
     };
     /** Video frame information. The video data format is YUV420. The buffer provides a pointer to a pointer. The interface cannot modify the pointer of the buffer, but can modify the content of the buffer only.
     */
@@ -190,14 +210,33 @@ namespace dii_media_kit {
         @note This timestamp is for rendering the video stream, and not for capturing the video stream.
         */
         int64_t render_time_ms;
+
+        /** Synchronized timestamp (ms) of this frame, from rtmp metadata, 0 if stream not carry it.
+        */
+        uint64_t sync_ts;
+
+        /** Reference of the buffer holding y/u/v planes, set for TYPE_YUV420 only.
+        @note Planes are valid in callback only, call DiiPlayer::RetainVideoFrame to keep them longer and ReleaseVideoFrame when done.
+        */
+        void* frame_handle;
     };
 
     typedef std::function<void (DiiVideoFrame& frame, void* custom)> DiiVideoFrameCallback;
+    // 缩略图回调, timestamp: 请求的时间(ms), code: 0 成功, frame: I420 缩略图, 失败为 nullptr, 仅回调内有效, 可用 DiiPlayer::RetainVideoFrame 保留
+    typedef std::function<void (int64_t timestamp, int32_t code, DiiVideoFrame* frame)> DiiThumbnailCallback;
     typedef std::function<void (DiiPlayerStatistics& statistics)> DiiPlayerStatisticsCallback;
     typedef std::function<void (int32_t width, int32_t height)> DiiResolutionCallback;
     typedef std::function<void (uint64_t ts)> DiiSyncTimestampCallback;
     // state: 播放器状态，code: 状态码/错误码, msg: 状态信息, custom_data: 自定义信息
     typedef std::function<void (DiiPlayerState state, int32_t code, const char* msg, void* custom_data)> DiiPlayerStateCallback;
+
+    typedef enum {
+        DII_VISUALIZATION_NONE = 0,     // 关闭
+        DII_VISUALIZATION_WAVEFORM,     // 波形, 512 个单声道采样 [-1, 1]
+        DII_VISUALIZATION_SPECTRUM,     // 频谱, 256 个频点幅度
+    } DiiVisualizationMode; // 音频可视化
+    // 音频可视化回调, 约 50 次/秒, data 仅回调内有效
+    typedef std::function<void (DiiVisualizationMode mode, const float* data, int32_t size, void* custom_data)> DiiVisualizationCallback;
     
     typedef struct DiiPlayerCallback {
         DiiVideoFrameCallback         video_frame_callback;// 播放器视频帧回调
@@ -205,6 +244,7 @@ namespace dii_media_kit {
         DiiSyncTimestampCallback      sync_ts_callback;    // rtmp 同步时间戳回调
         DiiResolutionCallback         resolution_callback; // 视频分辨率变更回调
         DiiPlayerStatisticsCallback   statistics_callback; // 播放器统计回调
+        DiiVisualizationCallback      visualization_callback; // 音频可视化回调, 需设置 DiiFFPlayOptions::visualization
         void* custom_data;                                   // 自定义数据端，回调会原样带回该指针
         
         DiiPlayerCallback() {
@@ -212,6 +252,47 @@ namespace dii_media_kit {
         }
     } DiiPlayerCallback; // 播放器回调
 
+    typedef enum {
+        DII_SYNC_AUDIO_MASTER = 0,  // 音频为主时钟
+        DII_SYNC_VIDEO_MASTER,      // 视频为主时钟
+        DII_SYNC_EXTERNAL_CLOCK,    // 外部时钟
+    } DiiSyncMaster; // 音视频同步主时钟
+
+    // 文件/点播播放(ffplay)配置，每个播放器独立，Start 前设置生效
+    typedef struct DiiFFPlayOptions {
+        int32_t decoder_threads;    // 解码线程数，0: 自动
+        int32_t lowres;             // 低分辨率解码级别，0: 关闭
+        bool fast;                  // 非标准加速解码
+        bool genpts;                // 生成缺失的 pts
+        int32_t framedrop;          // 丢帧，-1: 非视频主时钟时丢帧，0: 关闭，1: 开启
+        int32_t infinite_buffer;    // 不限制缓冲，-1: 实时流开启，0: 关闭，1: 开启
+        int32_t max_queue_bytes;    // 包队列上限(字节)，0: 按码率计算, 1MB ~ 128MB
+        int64_t probesize;          // 探测数据大小(字节)，0: ffmpeg 默认
+        bool fast_open;             // 快速打开: 小探测量, 容器头信息完整时跳过 find_stream_info
+        bool gapless_loop;          // 循环播放无缝衔接, 提前解复用片头, 不清空队列
+        bool adaptive_decode;       // 解码跟不上时逐级降低解码质量(跳过去块滤波/非参考帧 idct/lowres)
+        bool audio_track_cache;     // 缓存其他音轨的包, SelectAudioTrack 切换无需重新缓冲
+        DiiVisualizationMode visualization; // 音频可视化, 默认关闭
+        DiiSyncMaster sync_master;  // 同步主时钟
+
+        DiiFFPlayOptions() {
+            decoder_threads = 0;
+            lowres = 0;
+            fast = false;
+            genpts = false;
+            framedrop = -1;
+            infinite_buffer = -1;
+            max_queue_bytes = 0;
+            probesize = 0;
+            fast_open = false;
+            gapless_loop = false;
+            adaptive_decode = true;
+            audio_track_cache = false;
+            visualization = DII_VISUALIZATION_NONE;
+            sync_master = DII_SYNC_AUDIO_MASTER;
+        }
+    } DiiFFPlayOptions; // 播放配置
+
     typedef std::function<void (const void* audioSamples,
                      const size_t nSamples,
                      const size_t nBytesPerSample,
@@ -249,6 +330,12 @@ namespace dii_media_kit {
         static void SetDebugLog(LogSeverity severity);
         static void SetExternalStatisticsCallback(DiiPlayerStatisticsCallback callback);
         static void SetEventTrackinglCallback(DiiEventTrackingCallback callback);
+        // 所有播放器共享的内存预算(字节), <= 0 不限制, 默认 512MB
+        static void SetMemoryBudget(int64_t bytes);
+        // 缓存目录(关键帧索引等), 空则不缓存到磁盘
+        static void SetCacheDir(const char* path);
+        // http 点播磁盘缓存上限(字节), <= 0 不缓存, 默认 512MB
+        static void SetHttpCacheSize(int64_t bytes);
         
         // set radar callback
         static int SetRadarCallback(dii_radar::DiiRadarCallback callback);
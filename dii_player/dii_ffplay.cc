@@ -9,8 +9,15 @@
 #include "dii_ffplay.h"
 #include "dii_common.h"
 #include "dii_media_utils.h"
+#include "dii_memory_budget.h"
+#include "dii_keyframe_index.h"
+#include "dii_http_cache.h"
+#include "third_party/SoundTouch/SoundTouch/SoundTouch.h"
 #include "webrtc/base/logging.h"
 #include "webrtc/base/timeutils.h"
+#include "webrtc/base/refcount.h"
+#include "webrtc/common_video/include/video_frame_buffer.h"
+#include "webrtc/common_video/include/i420_buffer_pool.h"
 
 #include <signal.h>
 #include <thread>
@@ -47,7 +54,40 @@ extern "C" {
 using namespace dii_media_kit;
 
 #define MAX_QUEUE_SIZE (10 * 1024 * 1024)
+#define MAX_TEXTURE_LINESIZE 4096
+/* partial keyframe index, decode forward at most this long after seek (us) */
+#define KF_INDEX_MAX_PREROLL 2500000
+/* keep decoding non-ref frames this close to accurate seek target (s) */
+#define ACCURATE_SEEK_NONREF_MARGIN 0.5
+/* playback rate range, above skip rate non-ref frames are not decoded */
+#define PLAYBACK_RATE_MIN 0.5
+#define PLAYBACK_RATE_MAX 3.0
+#define PLAYBACK_RATE_SKIP_NONREF 2.0
+/* adaptive decode quality, stepped down when decode can not keep up with frame rate */
+#define DECODE_QUALITY_FULL 0
+#define DECODE_QUALITY_SKIP_LOOP_FILTER 1
+#define DECODE_QUALITY_SKIP_IDCT 2          // non-ref frames only
+#define DECODE_QUALITY_LOWRES 3
+#define DECODE_QUALITY_WINDOW_US 1000000
+#define DECODE_QUALITY_MIN_FRAMES 10
+/* percent of frame duration spent in decoder, percent of frames dropped late */
+#define DECODE_QUALITY_DOWN_LOAD 90
+#define DECODE_QUALITY_DOWN_DROPS 10
+#define DECODE_QUALITY_UP_LOAD 50
+/* stay at a level before stepping up, doubled when stepping up fails */
+#define DECODE_QUALITY_UP_HOLD_US 5000000
+#define DECODE_QUALITY_UP_HOLD_MAX_US 60000000
 #define MIN_FRAMES 50000
+/* buffering watermarks (ms) of cached packets, high one grows after repeated stalls */
+#define BUFFERING_LOW_MS 100
+#define BUFFERING_HIGH_MS 1000
+#define BUFFERING_HIGH_MAX_MS 8000
+#define BUFFERING_READ_AHEAD_MS 15000
+#define BUFFERING_STALL_WINDOW_MS 30000
+#define BUFFERING_DECAY_MS 60000
+/* packet queue byte cap by bitrate */
+#define MIN_QUEUE_SIZE (1 * 1024 * 1024)
+#define MAX_QUEUE_SIZE_LIMIT (128 * 1024 * 1024)
 #define EXTERNAL_CLOCK_MIN_FRAMES 2
 #define EXTERNAL_CLOCK_MAX_FRAMES 10
 
@@ -111,11 +151,31 @@ typedef struct PacketQueue {
 
     std::mutex* mutex;
     std::condition_variable *cond;
+    DiiMemoryAccount *mem_account;
+
+    MyAVPacketList *recycle_pkt;    /* free nodes, reused by put instead of av_malloc */
+    int recycle_count;
+    int nb_waiting;                 /* readers blocked in get, only then signal cond */
 } PacketQueue;
 
+/* max free nodes kept by one queue, the rest give back to system */
+#define PACKET_QUEUE_RECYCLE_MAX 1024
+/* side queue of an inactive audio track, kept from a little behind audio clock */
+#define AUDIO_SIDE_QUEUE_BEHIND 0.5
+#define AUDIO_SIDE_QUEUE_MAX_SIZE (2 * 1024 * 1024)
+
 #define VIDEO_PICTURE_QUEUE_SIZE 3
 #define SUBPICTURE_QUEUE_SIZE 16
 #define SAMPLE_QUEUE_SIZE 9
+/* pcm decoded ahead in device format */
+#define AUDIO_RING_TARGET_MS 60
+/* audio only: refill in bursts, fewer wakeups */
+#define AUDIO_ONLY_RING_TARGET_MS 300
+#define AUDIO_ONLY_RING_REFILL_MS 100
+/* visualization, waveform samples / spectrum bins = 2^(bits-1) */
+#define VIS_WAVE_SAMPLES 512
+#define VIS_RDFT_BITS 9
+#define AUDIO_RING_SIZE_MS 500
 #define FRAME_QUEUE_SIZE FFMAX(SAMPLE_QUEUE_SIZE, FFMAX(VIDEO_PICTURE_QUEUE_SIZE, SUBPICTURE_QUEUE_SIZE))
 
 typedef struct AudioParams {
@@ -151,6 +211,7 @@ typedef struct Frame {
     AVRational sar;
     int uploaded;
     int flip_v;
+    int64_t mem_bytes;    /* bytes charged to memory account */
 } Frame;
 
 typedef struct FrameQueue {
@@ -164,8 +225,30 @@ typedef struct FrameQueue {
     std::mutex* mutex;
     std::condition_variable *cond;
     PacketQueue *pktq;
+    DiiMemoryAccount *mem_account;
 } FrameQueue;
 
+/* s16 pcm in device format, written by audio fill thread, read by 10ms pull */
+typedef struct AudioRing {
+    uint8_t *data;
+    int size;
+    int rindex;
+    int level;              // bytes buffered
+    int target;             // fill up to, bytes
+    int refill;             // start fill below, bytes
+    int target_ms;
+    int refill_ms;
+    int freq;               // format of data
+    int channels;
+    int want_freq;          // format asked by device
+    int want_channels;
+    int serial;             // audio clock serial of buffered data
+    double clock;           // pts at end of buffered data
+    int abort_request;
+    std::mutex *mutex;
+    std::condition_variable *cond;
+} AudioRing;
+
 enum {
     AV_SYNC_AUDIO_MASTER, /* default choice */
     AV_SYNC_VIDEO_MASTER,
@@ -185,6 +268,9 @@ typedef struct Decoder {
     int64_t next_pts;
     AVRational next_pts_tb;
     std::thread *decoder_tid;
+    int64_t busy_us;                // time spent in send_packet / receive_frame
+    int lowres_req;                 // reopen with this lowres at next keyframe
+    int reopen_pending;             // old context is draining, reopen at its EOF
 } Decoder;
 
 typedef enum {
@@ -261,6 +347,17 @@ typedef struct _VideoState {
     int seek_flag_audio;
     int seek_flag_video;
     int seek_flag_subtitle;
+    double seek_decoded_pts;        // last video pts decoded but not shown before seek target
+
+    DiiKeyframeIndex *kf_index;
+    int kf_stream;
+    int64_t kf_last_ts;             // keyframe demuxed right before, INT64_MIN after seek
+
+    double playback_rate;
+    dii_soundtouch::SoundTouch *sound_touch;
+    int sound_touch_freq;
+    int sound_touch_channels;
+    int sound_touch_serial;
     
     int read_pause_return;
     AVFormatContext *ic;
@@ -293,12 +390,13 @@ typedef struct _VideoState {
     int audio_hw_buf_size;
     uint8_t *audio_buf;
     uint8_t *audio_buf1;
-    unsigned int audio_buf_size; /* in bytes */
+    uint8_t *audio_buf2;            // time stretched output
+    unsigned int audio_buf2_size;
     unsigned int audio_buf1_size;
-    int audio_buf_index; /* in bytes */
-    int audio_write_buf_size;
     int audio_volume;
     int muted;
+    AudioRing audio_ring;
+    std::thread *audio_fill_tid;
     struct AudioParams audio_src;
 #if CONFIG_AVFILTER
     struct AudioParams audio_filter_src;
@@ -310,7 +408,10 @@ typedef struct _VideoState {
 
     ShowMode show_mode;
 
-    int16_t sample_array[SAMPLE_ARRAY_SIZE];
+    int vis_mode;                   // DiiVisualizationMode, opt-in
+    AudioVisualizationCallback vis_callback;
+    int16_t *sample_array;          // SAMPLE_ARRAY_SIZE, only with visualization
+    float *vis_data;
     int sample_array_index;
     int last_i_start;
     RDFTContext *rdft;
@@ -331,6 +432,7 @@ typedef struct _VideoState {
     PacketQueue videoq;
     double max_frame_duration;      // maximum duration of a frame - above this, we consider the jump a timestamp discontinuity
     struct SwsContext *img_convert_ctx;
+    dii_media_kit::I420BufferPool *frame_pool;      // for non yuv420p display frame
     struct SwsContext *sub_convert_ctx;
     int eof;
 
@@ -348,6 +450,7 @@ typedef struct _VideoState {
 #endif
     //
     FFStatistic stat;
+    DiiHttpCache *http_cache;
     int64_t playable_duration_ms;
     int last_video_stream, last_audio_stream, last_subtitle_stream;
     
@@ -355,8 +458,19 @@ typedef struct _VideoState {
 
     int event_type;
     std::thread* event_loop_thread;
+    // refresh thread sleep until next frame deadline, wake up by seek/pause/new frame/stop.
+    std::mutex *refresh_mutex;
+    std::condition_variable *refresh_cond;
+    int refresh_pending;
 	int64_t start_pos;
 	WorkStat thr_stat;
+    std::mutex *thr_stat_mutex;
+    std::condition_variable *thr_stat_cond;
+    // startup cost, ms
+    int64_t open_start_time;
+    int open_time;
+    int probe_time;
+    int first_frame_time;
 
     VideoFrameCallback frame_callback = nullptr;
     bool start_complete_ = false;
@@ -364,10 +478,50 @@ typedef struct _VideoState {
     
     //state
     int is_buffering;
+    int buffering_armed;            // after first fill, no buffering state on start / seek
+    int buffering_count;
+    int cached_ms;                  // min cached duration of audio / video queue
+    int64_t buffering_end_time;     // ms
+    int buffer_high_ms;
+    int buffer_read_ahead_ms;
+    int max_queue_bytes;
     
     // loop
     int loop = 1;
+    // gapless loop, demux restart at eof and timestamps continue (AV_TIME_BASE)
+    int64_t loop_offset;
+    int64_t loop_start_ts;
+    int64_t loop_end_ts;
+    int64_t loop_duration;
+    int loop_count;
     int ff_stream_id;
+
+    // memory budget
+    DiiMemoryAccount *mem_account;
+    int mem_dropped_frames;
+
+    // packets of inactive audio tracks by stream index, opt-in by audio_track_cache
+    PacketQueue *audio_side_q;
+    int nb_audio_side_q;
+    int audio_track_req;            // stream index to switch to, -1: none
+
+    // adaptive decode quality, DECODE_QUALITY_*
+    int vdec_quality;
+    int vdec_quality_max;
+    int vdec_quality_changes;
+    int vdec_headroom;              // percent of frame duration not used by decoder
+    double vdec_frame_duration;
+    int vdec_frames;
+    int vdec_drops;                 // frame_drops_early + frame_drops_late at window start
+    int64_t vdec_window_start;
+    int64_t vdec_quality_time;
+    int64_t vdec_up_hold;
+
+    // per player options, copied from DiiFFPlayer
+    DiiFFPlayOptions opts;
+    int seek_by_bytes;
+    int infinite_buffer;
+    int64_t audio_callback_time;
 } VideoState;
 
 struct StreamContex {
@@ -381,24 +535,17 @@ static int audio_disable;
 static int video_disable;
 static int subtitle_disable;
 static const char* wanted_stream_spec[AVMEDIA_TYPE_NB] = {0};
-static int seek_by_bytes = -1;
 //static float seek_interval = 10;
 static int display_disable;
 //static int borderless;
-static int startup_volume = 100;
+static const int startup_volume = 100;
 static int show_status = 1;
-static int av_sync_type = AV_SYNC_AUDIO_MASTER;
 //static int64_t start_time = AV_NOPTS_VALUE;
 static int64_t duration = AV_NOPTS_VALUE;
-static int fast = 0;
-static int genpts = 0;
-static int lowres = 0;
 static int decoder_reorder_pts = -1;
 static int autoexit;
 //static int exit_on_keydown;
 //static int exit_on_mousedown;
-static int framedrop = -1;
-static int infinite_buffer = -1;
 static ShowMode show_mode = SHOW_MODE_NONE;
 static const char *audio_codec_name;
 static const char *subtitle_codec_name;
@@ -413,12 +560,16 @@ static char *afilters = NULL;
 #endif
 static int autorotate = 1;
 static int find_stream_info = 1;
+/* fast open, bounded probing */
+#define FAST_OPEN_PROBESIZE (64 * 1024)
+#define FAST_OPEN_ANALYZEDURATION (500 * 1000)
 
 /* current context */
 //static int is_full_screen;
-static int64_t audio_callback_time;
 
+/* shared by all players, only compared by data pointer, init once. */
 static AVPacket flush_pkt;
+static std::once_flag flush_pkt_once;
 
 #define FF_QUIT_EVENT    (SDL_USEREVENT + 2)
 
@@ -452,14 +603,6 @@ int64_t get_valid_channel_layout(int64_t channel_layout, int channels)
         return 0;
 }
 
-static void toggle_buffering(VideoState* is, int start_buffering) {
-    if(start_buffering) {
-        DII_LOG(LS_INFO, is->ff_stream_id, 600020) << "ffplay toggle start buffering.";
-    } else if(!start_buffering) {
-        DII_LOG(LS_INFO, is->ff_stream_id, 600022) << "ffplay toggle buffer ready.";
-    }
-}
-
 static int64_t dii_ffplay_position(void *is);
 static void ffp_check_buffering_l(VideoState* is) {
     int audio_time_base_valid = 0;
@@ -497,6 +640,20 @@ static void ffp_check_buffering_l(VideoState* is) {
               is->playable_duration_ms = buf_time_position;
         }
         DII_LOG(LS_VERBOSE, is->ff_stream_id, 0) << "queue playable_duration_ms: " << is->playable_duration_ms;
+
+    if (is->http_cache) {
+        DiiHttpCache::Statistic cache;
+        is->http_cache->GetStatistic(&cache);
+        is->stat.cache_physical_pos = cache.physical_pos;
+        is->stat.cache_file_pos = cache.read_pos;
+        is->stat.cache_file_forwards = cache.forwards;
+        is->stat.cache_count_bytes = cache.cached_bytes;
+        is->stat.logical_file_size = cache.file_size;
+        is->stat.byte_count = cache.download_bytes;
+        is->stat.buf_forwards = cache.forwards;
+        is->stat.buf_backwards = cache.backwards;
+        is->stat.buf_capacity = cache.prefetch_window;
+    }
 }
 
 static void ffp_track_statistic_l(VideoState* is, AVStream *st, PacketQueue *q, FFTrackCacheStatistic *cache) {
@@ -522,9 +679,15 @@ static int packet_queue_put_private(PacketQueue *q, AVPacket *pkt)
     if (q->abort_request)
         return -1;
 
-    pkt1 = (MyAVPacketList *)av_malloc(sizeof(MyAVPacketList));
-    if (!pkt1)
-        return -1;
+    pkt1 = q->recycle_pkt;
+    if (pkt1) {
+        q->recycle_pkt = pkt1->next;
+        q->recycle_count--;
+    } else {
+        pkt1 = (MyAVPacketList *)av_malloc(sizeof(MyAVPacketList));
+        if (!pkt1)
+            return -1;
+    }
     pkt1->pkt = *pkt;
     pkt1->next = NULL;
     if (pkt == &flush_pkt)
@@ -539,11 +702,26 @@ static int packet_queue_put_private(PacketQueue *q, AVPacket *pkt)
     q->nb_packets++;
     q->size += pkt1->pkt.size + sizeof(*pkt1);
     q->duration += pkt1->pkt.duration;
+    if (q->mem_account)
+        q->mem_account->AddCompressed(pkt1->pkt.size + sizeof(*pkt1));
     /* XXX: should duplicate packet data in DV case */
-    q->cond->notify_one();
+    if (q->nb_waiting > 0)
+        q->cond->notify_one();
     return 0;
 }
 
+/* must hold q->mutex */
+static void packet_queue_recycle(PacketQueue *q, MyAVPacketList *pkt1)
+{
+    if (q->recycle_count >= PACKET_QUEUE_RECYCLE_MAX) {
+        av_free(pkt1);
+        return;
+    }
+    pkt1->next = q->recycle_pkt;
+    q->recycle_pkt = pkt1;
+    q->recycle_count++;
+}
+
 static int packet_queue_put(PacketQueue *q, AVPacket *pkt)
 {
     int ret;
@@ -590,18 +768,28 @@ static void packet_queue_flush(PacketQueue *q)
     for (pkt = q->first_pkt; pkt; pkt = pkt1) {
         pkt1 = pkt->next;
         av_packet_unref(&pkt->pkt);
-        av_freep(&pkt);
+        packet_queue_recycle(q, pkt);
     }
     q->last_pkt = NULL;
     q->first_pkt = NULL;
     q->nb_packets = 0;
+    if (q->mem_account)
+        q->mem_account->AddCompressed(-q->size);
     q->size = 0;
     q->duration = 0;
 }
 
 static void packet_queue_destroy(PacketQueue *q)
 {
+    MyAVPacketList *pkt, *pkt1;
+
     packet_queue_flush(q);
+    for (pkt = q->recycle_pkt; pkt; pkt = pkt1) {
+        pkt1 = pkt->next;
+        av_free(pkt);
+    }
+    q->recycle_pkt = NULL;
+    q->recycle_count = 0;
     delete q->mutex;
     delete q->cond;
 }
@@ -620,6 +808,52 @@ static void packet_queue_start(PacketQueue *q)
     packet_queue_put_private(q, &flush_pkt);
 }
 
+/* drop packets from head which end before min_pts (s), or while queue is over max_size. */
+static void packet_queue_trim(PacketQueue *q, AVRational tb, double min_pts, int max_size)
+{
+    MyAVPacketList *pkt1;
+
+    std::unique_lock<std::mutex> lck(*q->mutex);
+    while ((pkt1 = q->first_pkt)) {
+        int64_t ts = pkt1->pkt.pts != AV_NOPTS_VALUE ? pkt1->pkt.pts : pkt1->pkt.dts;
+        int behind = !isnan(min_pts) && ts != AV_NOPTS_VALUE &&
+                     (ts + FFMAX(pkt1->pkt.duration, 0)) * av_q2d(tb) < min_pts;
+        if (!behind && q->size <= max_size)
+            break;
+        q->first_pkt = pkt1->next;
+        if (!q->first_pkt)
+            q->last_pkt = NULL;
+        q->nb_packets--;
+        q->size -= pkt1->pkt.size + sizeof(*pkt1);
+        q->duration -= pkt1->pkt.duration;
+        if (q->mem_account)
+            q->mem_account->AddCompressed(-(int64_t)(pkt1->pkt.size + sizeof(*pkt1)));
+        av_packet_unref(&pkt1->pkt);
+        packet_queue_recycle(q, pkt1);
+    }
+}
+
+/* move all packets of src to the end of dst, they take the current serial of dst. */
+static void packet_queue_move(PacketQueue *dst, PacketQueue *src)
+{
+    MyAVPacketList *pkt1;
+
+    std::unique_lock<std::mutex> slck(*src->mutex);
+    std::unique_lock<std::mutex> dlck(*dst->mutex);
+    while ((pkt1 = src->first_pkt)) {
+        src->first_pkt = pkt1->next;
+        if (src->mem_account)
+            src->mem_account->AddCompressed(-(int64_t)(pkt1->pkt.size + sizeof(*pkt1)));
+        if (pkt1->pkt.data != flush_pkt.data && packet_queue_put_private(dst, &pkt1->pkt) < 0)
+            av_packet_unref(&pkt1->pkt);
+        packet_queue_recycle(src, pkt1);
+    }
+    src->last_pkt = NULL;
+    src->nb_packets = 0;
+    src->size = 0;
+    src->duration = 0;
+}
+
 /* return < 0 if aborted, 0 if no packet and > 0 if packet.  */
 static int packet_queue_get(VideoState* is, PacketQueue *q, AVPacket *pkt, int block, int *serial, int finished)
 {
@@ -640,25 +874,21 @@ static int packet_queue_get(VideoState* is, PacketQueue *q, AVPacket *pkt, int b
             q->nb_packets--;
             q->size -= pkt1->pkt.size + sizeof(*pkt1);
             q->duration -= pkt1->pkt.duration;
+            if (q->mem_account)
+                q->mem_account->AddCompressed(-(int64_t)(pkt1->pkt.size + sizeof(*pkt1)));
             *pkt = pkt1->pkt;
             if (serial)
                 *serial = pkt1->serial;
-            av_free(pkt1);
+            packet_queue_recycle(q, pkt1);
             ret = 1;
-            if(is->is_buffering && q->nb_packets > 15 && !finished) {
-                is->is_buffering = 0;
-                toggle_buffering(is, 0);
-            }
             break;
         } else if (!block) {
             ret = 0;
             break;
         } else {
-            if(!is->is_buffering && !finished) {
-                is->is_buffering = 1;
-                toggle_buffering(is, 1);
-            }
+            q->nb_waiting++;
             q->cond->wait(lck);
+            q->nb_waiting--;
         }
     }
     return ret;
@@ -673,6 +903,50 @@ static void decoder_init(Decoder *d, AVCodecContext *avctx, PacketQueue *queue,
     d->pkt_serial = -1;
 }
 
+/* lowres is read by decoders only on open, switch to a new context at keyframe,
+ * after frames buffered in the old one are drained. */
+static int decoder_reopen(VideoState *is, Decoder *d)
+{
+    AVCodecContext *old = d->avctx;
+    AVStream *st = old->codec_type == AVMEDIA_TYPE_VIDEO ? is->video_st : NULL;
+    AVCodecContext *avctx;
+    AVDictionary *opts = NULL;
+    int ret;
+
+    if (!st)
+        return AVERROR(EINVAL);
+    avctx = avcodec_alloc_context3(NULL);
+    if (!avctx)
+        return AVERROR(ENOMEM);
+    if ((ret = avcodec_parameters_to_context(avctx, st->codecpar)) < 0)
+        goto fail;
+    avctx->pkt_timebase = st->time_base;
+    avctx->codec_id = old->codec_id;
+    avctx->flags2 = old->flags2;
+    avctx->skip_frame = old->skip_frame;
+    avctx->skip_loop_filter = old->skip_loop_filter;
+    avctx->skip_idct = old->skip_idct;
+    avctx->lowres = d->lowres_req;
+    av_dict_set_int(&opts, "threads", old->thread_count, 0);
+    av_dict_set_int(&opts, "lowres", d->lowres_req, 0);
+    av_dict_set(&opts, "refcounted_frames", "1", 0);
+    if ((ret = avcodec_open2(avctx, (AVCodec *)old->codec, &opts)) < 0)
+        goto fail;
+    av_dict_free(&opts);
+
+    DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "video decoder reopen, lowres: " << old->lowres << " -> " << avctx->lowres;
+    d->avctx = avctx;
+    avcodec_free_context(&old);
+    return 0;
+
+fail:
+    DII_LOG(LS_WARNING, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "video decoder reopen failed: " << ret;
+    av_dict_free(&opts);
+    avcodec_free_context(&avctx);
+    d->lowres_req = old->lowres;    // do not retry every keyframe
+    return ret;
+}
+
 static int decoder_decode_frame(VideoState* is, Decoder *d, AVFrame *frame, AVSubtitle *sub) {
     int ret = AVERROR(EAGAIN);
 
@@ -685,9 +959,11 @@ static int decoder_decode_frame(VideoState* is, Decoder *d, AVFrame *frame, AVSu
                     return -1;
 
                 switch (d->avctx->codec_type) {
-                    case AVMEDIA_TYPE_VIDEO:
+                    case AVMEDIA_TYPE_VIDEO: {
                         // 取出解码后的帧
+                        int64_t t = av_gettime_relative();
                         ret = avcodec_receive_frame(d->avctx, frame);
+                        d->busy_us += av_gettime_relative() - t;
                         if (ret >= 0) {
                             if (decoder_reorder_pts == -1) {
                                 frame->pts = frame->best_effort_timestamp;
@@ -696,6 +972,7 @@ static int decoder_decode_frame(VideoState* is, Decoder *d, AVFrame *frame, AVSu
                             }
                         }
                         break;
+                    }
                     case AVMEDIA_TYPE_AUDIO:
                         ret = avcodec_receive_frame(d->avctx, frame);
                         if (ret >= 0) {
@@ -713,6 +990,12 @@ static int decoder_decode_frame(VideoState* is, Decoder *d, AVFrame *frame, AVSu
                     default:
                         break;
                 }
+                if (ret == AVERROR_EOF && d->reopen_pending) {
+                    d->reopen_pending = 0;
+                    if (decoder_reopen(is, d) < 0)
+                        avcodec_flush_buffers(d->avctx);
+                    break;
+                }
                 if (ret == AVERROR_EOF) {
                     d->finished = d->pkt_serial;
                     avcodec_flush_buffers(d->avctx);
@@ -735,8 +1018,18 @@ static int decoder_decode_frame(VideoState* is, Decoder *d, AVFrame *frame, AVSu
             }
         } while (d->queue->serial != d->pkt_serial);
 
+        if (pkt.data != flush_pkt.data && d->lowres_req != d->avctx->lowres && (pkt.flags & AV_PKT_FLAG_KEY)) {
+            // keep keyframe for the new context, output what old context still holds.
+            avcodec_send_packet(d->avctx, NULL);
+            d->reopen_pending = 1;
+            d->packet_pending = 1;
+            av_packet_move_ref(&d->pkt, &pkt);
+            continue;
+        }
+
         if (pkt.data == flush_pkt.data) {
             avcodec_flush_buffers(d->avctx);
+            d->reopen_pending = 0;
             d->finished = 0;
             d->next_pts = d->start_pts;
             d->next_pts_tb = d->start_pts_tb;
@@ -755,7 +1048,10 @@ static int decoder_decode_frame(VideoState* is, Decoder *d, AVFrame *frame, AVSu
                 }
             } else {
                 // 给解码器发送包用于解码
-                if (avcodec_send_packet(d->avctx, &pkt) == AVERROR(EAGAIN)) {
+                int64_t t = av_gettime_relative();
+                ret = avcodec_send_packet(d->avctx, &pkt);
+                d->busy_us += av_gettime_relative() - t;
+                if (ret == AVERROR(EAGAIN)) {
                     DII_LOG(LS_ERROR, 0, 600010) << "Receive_frame and send_packet both returned EAGAIN, which is an API violation.";
                     d->packet_pending = 1;
                     av_packet_move_ref(&d->pkt, &pkt);
@@ -771,8 +1067,11 @@ static void decoder_destroy(Decoder *d) {
     avcodec_free_context(&d->avctx);
 }
 
-static void frame_queue_unref_item(Frame *vp)
+static void frame_queue_unref_item(FrameQueue *f, Frame *vp)
 {
+    if (f->mem_account && vp->mem_bytes)
+        f->mem_account->AddDecoded(-vp->mem_bytes);
+    vp->mem_bytes = 0;
     av_frame_unref(vp->frame);
     avsubtitle_free(&vp->sub);
 }
@@ -804,7 +1103,7 @@ static void frame_queue_destory(FrameQueue *f)
     int i;
     for (i = 0; i < f->max_size; i++) {
         Frame *vp = &f->queue[i];
-        frame_queue_unref_item(vp);
+        frame_queue_unref_item(f, vp);
         av_frame_free(&vp->frame);
     }
     delete f->mutex;
@@ -867,6 +1166,13 @@ static Frame *frame_queue_peek_readable(FrameQueue *f)
 
 static void frame_queue_push(FrameQueue *f)
 {
+    Frame *vp = &f->queue[f->windex];
+    vp->mem_bytes = 0;
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && vp->frame->buf[i]; i++)
+        vp->mem_bytes += vp->frame->buf[i]->size;
+    if (f->mem_account && vp->mem_bytes)
+        f->mem_account->AddDecoded(vp->mem_bytes);
+
     if (++f->windex == f->max_size)
         f->windex = 0;
     std::unique_lock<std::mutex> lck(*f->mutex);
@@ -880,7 +1186,7 @@ static void frame_queue_next(FrameQueue *f)
         f->rindex_shown = 1;
         return;
     }
-    frame_queue_unref_item(&f->queue[f->rindex]);
+    frame_queue_unref_item(f, &f->queue[f->rindex]);
     if (++f->rindex == f->max_size)
         f->rindex = 0;
     std::unique_lock<std::mutex> lck(*f->mutex);
@@ -945,15 +1251,61 @@ static double get_rotation(AVStream *st)
     return theta;
 }
 
+/* VideoFrameBuffer reference the decoded AVFrame, planes are used without copy,
+ * released when last VideoFrame holding it is gone.
+ */
+class DiiAVFrameBuffer : public dii_media_kit::VideoFrameBuffer {
+public:
+    explicit DiiAVFrameBuffer(const AVFrame *src) {
+        frame_ = av_frame_alloc();
+        if (frame_ && av_frame_ref(frame_, src) < 0)
+            av_frame_free(&frame_);
+    }
+
+    int width() const override { return frame_ ? frame_->width : 0; }
+    int height() const override { return frame_ ? frame_->height : 0; }
+
+    const uint8_t* DataY() const override { return frame_ ? frame_->data[0] : nullptr; }
+    const uint8_t* DataU() const override { return frame_ ? frame_->data[1] : nullptr; }
+    const uint8_t* DataV() const override { return frame_ ? frame_->data[2] : nullptr; }
+    int StrideY() const override { return frame_ ? frame_->linesize[0] : 0; }
+    int StrideU() const override { return frame_ ? frame_->linesize[1] : 0; }
+    int StrideV() const override { return frame_ ? frame_->linesize[2] : 0; }
+
+    void* native_handle() const override { return nullptr; }
+    dii_rtc::scoped_refptr<dii_media_kit::VideoFrameBuffer> NativeToI420Buffer() override {
+        RTC_NOTREACHED();
+        return nullptr;
+    }
+
+protected:
+    ~DiiAVFrameBuffer() override {
+        av_frame_free(&frame_);
+    }
+
+private:
+    AVFrame *frame_;
+};
+
+static void mark_first_frame(VideoState *is)
+{
+    if (is->first_frame_time)
+        return;
+    is->first_frame_time = (int)FFMAX(dii_rtc::TimeMillis() - is->open_start_time, 1);
+    DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "first frame, open: " << is->open_time
+        << " ms, probe: " << is->probe_time << " ms, first frame: " << is->first_frame_time << " ms.";
+}
+
+/* always -1: frame stays not uploaded, so a redisplay (pause, step) delivers it again. */
 static int upload_texture(VideoState* is, AVFrame *frame, struct SwsContext **img_convert_ctx) {
     if(frame->width <= 0 || frame->height <= 0) {
         return -1;
     }
 
     // limit to 4k resolution
-    if (frame->linesize[0] <= 0 || frame->linesize[0] > 2160||
-        frame->linesize[1] <= 0 || frame->linesize[1] > 2160 ||
-        frame->linesize[2] <= 0 || frame->linesize[2] > 2160 ||
+    if (frame->linesize[0] <= 0 || frame->linesize[0] > MAX_TEXTURE_LINESIZE ||
+        frame->linesize[1] <= 0 || frame->linesize[1] > MAX_TEXTURE_LINESIZE ||
+        frame->linesize[2] <= 0 || frame->linesize[2] > MAX_TEXTURE_LINESIZE ||
         frame->data[0] == nullptr || frame->data[1] == nullptr || frame->data[2] == nullptr) {
         DII_LOG(LS_ERROR, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "upoad texture: avframe error.";
         is->state_callback(DII_STATE_ERROR, DII_CODE_COMMON_ERROR, "upoad texture: avframe error.");
@@ -985,97 +1337,66 @@ static int upload_texture(VideoState* is, AVFrame *frame, struct SwsContext **im
         is->refresh_display--;
     }
     
-    if (frame->format == AV_PIX_FMT_YUV420P) {
-        if (is->frame_callback != nullptr) {
-            dii_media_kit::VideoFrame video_frame;
-            int ret = -1;
-            if(frame->data[0] && frame->data[1] && frame->data[2] && frame->linesize[0] > 0 && frame->linesize[1] > 0 && frame->linesize[2] > 0){
-              //  if(frame->width == frame->linesize[0] && frame->width/2 == frame->linesize[1] && frame->linesize[1] == frame->linesize[2]){
-                    try{
-                        ret = video_frame.CreateFrame(frame->data[0], frame->data[1], frame->data[2],
-                                            frame->width,
-                                            frame->height,
-                                            frame->linesize[0], frame->linesize[1], frame->linesize[2],
-                                            frame_rotation);
-                    }catch(...){
-                    }
-            //    }
-            }
-            if(ret == 0) {
-                is->frame_callback(video_frame);
-            } else {
-                DII_LOG(LS_ERROR, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "Create Display Video Frame Faild.";
-            }
-        }
+    if (is->frame_callback == nullptr) {
         return -1;
-    } else {
-        int ret = 0;
-        uint8_t *dst_frame_data[4] = {nullptr};
-        int dst_frame_linesize[4]  = {0};
-        ret = av_image_alloc(dst_frame_data,
-                             dst_frame_linesize,
-                             frame->width,
-                             frame->height,
-                             AV_PIX_FMT_YUV420P,
-                             1);
-        if (ret < 0) {
-            DII_LOG(LS_ERROR, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "Could not allocate raw video buffer.";
-            is->state_callback(DII_STATE_ERROR, DII_CODE_COMMON_ERROR, "Could not allocate raw video buffer.");
-            return ret;
-        }
-    
-        *img_convert_ctx = sws_getCachedContext(*img_convert_ctx,
-                                                frame->width,
-                                                frame->height,
-                                                (AVPixelFormat)frame->format,
-                                                frame->width,
-                                                frame->height,
-                                                AV_PIX_FMT_YUV420P,
-                                                sws_flags,
-                                                nullptr,
-                                                nullptr,
-                                                nullptr);
-        if (*img_convert_ctx != nullptr) {
-            sws_scale(*img_convert_ctx,
-                      (const uint8_t * const *)frame->data,
-                      frame->linesize,
-                      0,
-                      frame->height,
-                      dst_frame_data,
-                      dst_frame_linesize);
-
-            dii_media_kit::VideoFrame video_frame;
-            int ret  = -1;
-            if(dst_frame_data[0] && dst_frame_data[1] && dst_frame_data[0] && dst_frame_linesize[0] > 0 && dst_frame_linesize[1] > 0 && dst_frame_linesize[2] > 0){
-             //   if(frame->width == dst_frame_linesize[0] && frame->width/2 == dst_frame_linesize[1] && dst_frame_linesize[1] == dst_frame_linesize[2]){
-                    try{
-                        ret = video_frame.CreateFrame(dst_frame_data[0],
-                                           dst_frame_data[1],
-                                           dst_frame_data[2],
-                                           frame->width,
-                                           frame->height,
-                                           dst_frame_linesize[0],
-                                           dst_frame_linesize[1],
-                                           dst_frame_linesize[2],
-                                           frame_rotation);
-                    }catch(...){
-                    }
-            //    }
-            }
-            if(ret == 0) {
-                is->frame_callback(video_frame);
-            } else {
-                DII_LOG(LS_ERROR, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "Create Display Video Frame Faild.";
-            }
-            av_freep(&dst_frame_data[0]);
+    }
+
+    if (frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUVJ420P) {
+        // zero copy, display the decoded planes directly.
+        dii_rtc::scoped_refptr<dii_media_kit::VideoFrameBuffer> buffer(
+            new dii_rtc::RefCountedObject<DiiAVFrameBuffer>(frame));
+        if (!buffer->DataY()) {
+            DII_LOG(LS_ERROR, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "Create Display Video Frame Faild.";
             return -1;
-        } else {
-            ret = -1;
-            DII_LOG(LS_ERROR, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "Cannot initialize the conversion context.";
-            is->state_callback(DII_STATE_ERROR, DII_CODE_COMMON_ERROR, "Cannot initialize the conversion context.");
-            return ret;
         }
+        dii_media_kit::VideoFrame video_frame(buffer, 0, 0, frame_rotation);
+        is->frame_callback(video_frame);
+        mark_first_frame(is);
+        return -1;
     }
+
+    // other format convert to pooled i420 buffer, no per frame allocation.
+    *img_convert_ctx = sws_getCachedContext(*img_convert_ctx,
+                                            frame->width,
+                                            frame->height,
+                                            (AVPixelFormat)frame->format,
+                                            frame->width,
+                                            frame->height,
+                                            AV_PIX_FMT_YUV420P,
+                                            sws_flags,
+                                            nullptr,
+                                            nullptr,
+                                            nullptr);
+    if (*img_convert_ctx == nullptr) {
+        DII_LOG(LS_ERROR, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "Cannot initialize the conversion context.";
+        is->state_callback(DII_STATE_ERROR, DII_CODE_COMMON_ERROR, "Cannot initialize the conversion context.");
+        return -1;
+    }
+
+    if (!is->frame_pool) {
+        is->frame_pool = new dii_media_kit::I420BufferPool();
+    }
+    dii_rtc::scoped_refptr<dii_media_kit::I420Buffer> buffer = is->frame_pool->CreateBuffer(frame->width, frame->height);
+    if (!buffer) {
+        DII_LOG(LS_ERROR, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "Could not allocate raw video buffer.";
+        is->state_callback(DII_STATE_ERROR, DII_CODE_COMMON_ERROR, "Could not allocate raw video buffer.");
+        return -1;
+    }
+
+    uint8_t *dst_frame_data[4] = {buffer->MutableDataY(), buffer->MutableDataU(), buffer->MutableDataV(), nullptr};
+    int dst_frame_linesize[4]  = {buffer->StrideY(), buffer->StrideU(), buffer->StrideV(), 0};
+    sws_scale(*img_convert_ctx,
+              (const uint8_t * const *)frame->data,
+              frame->linesize,
+              0,
+              frame->height,
+              dst_frame_data,
+              dst_frame_linesize);
+
+    dii_media_kit::VideoFrame video_frame(buffer, 0, 0, frame_rotation);
+    is->frame_callback(video_frame);
+    mark_first_frame(is);
+    return -1;
 }
 
 static void video_image_display(VideoState *is)
@@ -1092,6 +1413,85 @@ static void video_image_display(VideoState *is)
     }
 }
 
+static void audio_ring_flush(AudioRing *ring)
+{
+    ring->rindex = 0;
+    ring->level = 0;
+    ring->serial = -1;
+    ring->clock = NAN;
+}
+
+static void audio_ring_abort(AudioRing *ring)
+{
+    std::unique_lock<std::mutex> lck(*ring->mutex);
+    ring->abort_request = 1;
+    ring->cond->notify_all();
+}
+
+/* fill thread sleeps without timeout while paused, buffering or out of frames */
+static void audio_ring_wakeup(AudioRing *ring)
+{
+    if (!ring->mutex)
+        return;
+    std::unique_lock<std::mutex> lck(*ring->mutex);
+    ring->cond->notify_all();
+}
+
+/* dst = src * volume / 1024, plain loop left to compiler vectorization (NEON / SSE2) */
+static void audio_copy_volume(int16_t *dst, const int16_t *src, int nb_samples, int volume)
+{
+    if (volume >= 1024) {
+        memcpy(dst, src, nb_samples * sizeof(int16_t));
+    } else if (volume <= 0) {
+        memset(dst, 0, nb_samples * sizeof(int16_t));
+    } else {
+        for (int i = 0; i < nb_samples; i++)
+            dst[i] = (int16_t)((src[i] * volume) >> 10);
+    }
+}
+
+/* block until all written or abort, called by audio fill thread only */
+static int audio_ring_write(AudioRing *ring, const uint8_t *buf, int len, double clock, int serial, double bytes_per_media_sec)
+{
+    std::unique_lock<std::mutex> lck(*ring->mutex);
+    // data before seek is useless once new serial comes
+    if (ring->serial != serial) {
+        audio_ring_flush(ring);
+        ring->serial = serial;
+    }
+    while (len > 0 && !ring->abort_request) {
+        if (ring->level >= ring->size) {
+            ring->cond->wait(lck);
+            continue;
+        }
+        int windex = (ring->rindex + ring->level) % ring->size;
+        int n = FFMIN(len, FFMIN(ring->size - ring->level, ring->size - windex));
+        memcpy(ring->data + windex, buf, n);
+        ring->level += n;
+        buf += n;
+        len -= n;
+        ring->clock = clock - len / bytes_per_media_sec;
+    }
+    return ring->level;
+}
+
+/* one pass copy with volume, return bytes read */
+static int audio_ring_read(AudioRing *ring, uint8_t *stream, int len, int volume)
+{
+    int read = 0;
+    while (read < len && ring->level > 0) {
+        int n = FFMIN(len - read, FFMIN(ring->level, ring->size - ring->rindex));
+        n &= ~1;
+        if (n <= 0)
+            break;
+        audio_copy_volume((int16_t *)(stream + read), (const int16_t *)(ring->data + ring->rindex), n / 2, volume);
+        ring->rindex = (ring->rindex + n) % ring->size;
+        ring->level -= n;
+        read += n;
+    }
+    return read;
+}
+
 static void stream_component_close(VideoState *is, int stream_index)
 {
     AVFormatContext *ic = is->ic;
@@ -1103,12 +1503,23 @@ static void stream_component_close(VideoState *is, int stream_index)
 
     switch (codecpar->codec_type) {
         case AVMEDIA_TYPE_AUDIO:
+            audio_ring_abort(&is->audio_ring);
             decoder_abort(&is->auddec, &is->sampq);
+            if (is->audio_fill_tid && is->audio_fill_tid->joinable())
+                is->audio_fill_tid->join();
+            delete is->audio_fill_tid;
+            is->audio_fill_tid = nullptr;
+            audio_ring_flush(&is->audio_ring);
+            is->audio_ring.abort_request = 0;
             decoder_destroy(&is->auddec);
             swr_free(&is->swr_ctx);
             av_freep(&is->audio_buf1);
             is->audio_buf1_size = 0;
+            av_freep(&is->audio_buf2);
+            is->audio_buf2_size = 0;
             is->audio_buf = NULL;
+            delete is->sound_touch;
+            is->sound_touch = NULL;
 
             if (is->rdft) {
                 av_rdft_end(is->rdft);
@@ -1152,7 +1563,7 @@ static void stream_close(VideoState *is)
 {
     /* XXX: use a special url_shutdown call to abort parse cleanly */
     is->abort_request = 1;
-	if (is->read_tid->joinable()) {
+	if (is->read_tid && is->read_tid->joinable()) {
 		is->read_tid->join();
 	}   
 
@@ -1168,28 +1579,73 @@ static void stream_close(VideoState *is)
         stream_component_close(is, is->subtitle_stream);
 
     avformat_close_input(&is->ic);
+    // custom io is not freed by avformat_close_input
+    delete is->http_cache;
+    is->http_cache = NULL;
 
     packet_queue_destroy(&is->videoq);
     packet_queue_destroy(&is->audioq);
     packet_queue_destroy(&is->subtitleq);
+    for (int i = 0; i < is->nb_audio_side_q; i++) {
+        if (is->audio_side_q[i].mutex)
+            packet_queue_destroy(&is->audio_side_q[i]);
+    }
+    av_freep(&is->audio_side_q);
+    is->nb_audio_side_q = 0;
     
     /* free all pictures */
     frame_queue_destory(&is->pictq);
     frame_queue_destory(&is->sampq);
     frame_queue_destory(&is->subpq);
+
+    DiiMemoryBudget::Instance()->ReleaseAccount(is->mem_account);
+    is->mem_account = NULL;
+
+    if (is->kf_index) {
+        is->kf_index->Save();
+        delete is->kf_index;
+        is->kf_index = NULL;
+    }
     
     // must delete after call 'stream_component_close(is, is->audio_stream)'
     // otherwith audio decode thread still use continue_read_thread, then crash.
     delete is->continue_read_thread;
     is->continue_read_thread = nullptr;
+
+    delete is->refresh_cond;
+    is->refresh_cond = nullptr;
+    av_freep(&is->audio_ring.data);
+    av_freep(&is->sample_array);
+    av_freep(&is->vis_data);
+    delete is->audio_ring.cond;
+    is->audio_ring.cond = nullptr;
+    delete is->audio_ring.mutex;
+    is->audio_ring.mutex = nullptr;
+    delete is->thr_stat_cond;
+    is->thr_stat_cond = nullptr;
+    delete is->thr_stat_mutex;
+    is->thr_stat_mutex = nullptr;
+    delete is->refresh_mutex;
+    is->refresh_mutex = nullptr;
     
     sws_freeContext(is->img_convert_ctx);
+    delete is->frame_pool;
+    is->frame_pool = nullptr;
     sws_freeContext(is->sub_convert_ctx);
     av_free(is->filename);
 
     av_free(is);
 }
 
+static void refresh_loop_wakeup(VideoState *is)
+{
+    if (!is->refresh_cond)
+        return;
+    std::unique_lock<std::mutex> lck(*is->refresh_mutex);
+    is->refresh_pending = 1;
+    is->refresh_cond->notify_one();
+}
+
 static void do_exit(VideoState *is)
 {
     if (is) {
@@ -1321,13 +1777,14 @@ static int64_t compute_seek_pos(VideoState *is, int64_t pos) {
 static void stream_seek(VideoState *is, int64_t pos, int64_t rel, int seek_by_bytes)
 {
     if (!is->seek_req) {
-        is->seek_pos = compute_seek_pos(is, pos);
+        is->seek_pos = (!seek_by_bytes && pos > is->ic->duration) ? is->ic->duration : pos;
         is->seek_rel = rel;
         is->seek_flags &= ~(AVSEEK_FLAG_BYTE);
         if (seek_by_bytes)
             is->seek_flags |=  AVSEEK_FLAG_BYTE;
         is->seek_req = 1;
         is->continue_read_thread->notify_one();
+        refresh_loop_wakeup(is);
     }
 }
 
@@ -1343,13 +1800,17 @@ static void stream_toggle_pause(VideoState *is)
         set_clock(&is->audclk, get_clock(&is->audclk), is->audclk.serial);
     }
     set_clock(&is->extclk, get_clock(&is->extclk), is->extclk.serial);
-    is->paused = is->audclk.paused = is->vidclk.paused = is->extclk.paused = !is->paused;
+    is->paused = !is->paused;
+    // clocks keep stopped until buffering finish
+    is->audclk.paused = is->vidclk.paused = is->extclk.paused = is->paused || is->is_buffering;
+    audio_ring_wakeup(&is->audio_ring);
 }
 
 static void toggle_pause(VideoState *is)
 {
     stream_toggle_pause(is);
     is->step = 0;
+    refresh_loop_wakeup(is);
 }
 
 static void toggle_mute(VideoState *is)
@@ -1417,6 +1878,78 @@ static void update_video_pts(VideoState *is, double pts, int64_t pos, int serial
     sync_clock_to_slave(&is->extclk, &is->vidclk);
 }
 
+static inline int compute_mod(int a, int b)
+{
+    return a < 0 ? a%b + b : a%b;
+}
+
+/* waveform or spectrum of samples being played, ported from ffplay video_audio_display */
+static void audio_visualization_display(VideoState *is)
+{
+    int channels = is->audio_tgt.channels;
+    int freq = is->audio_tgt.freq;
+    if (channels <= 0 || freq <= 0 || !is->vis_callback)
+        return;
+
+    int nb_freq = 1 << (VIS_RDFT_BITS - 1);
+    int n = is->vis_mode == DII_VISUALIZATION_SPECTRUM ? 2 * nb_freq : VIS_WAVE_SAMPLES;
+
+    /* samples buffered after the ones being played: ring, device, minus time since last pull */
+    int level;
+    {
+        std::unique_lock<std::mutex> lck(*is->audio_ring.mutex);
+        level = is->audio_ring.level;
+    }
+    int64_t time_diff = av_gettime_relative() - is->audio_callback_time;
+    int delay = (2 * is->audio_hw_buf_size + level) / (channels * 2);
+    delay -= (int)(time_diff * freq / 1000000);
+    delay = FFMAX(delay, 0) + n;
+    int i_start = compute_mod(is->sample_array_index - delay * channels, SAMPLE_ARRAY_SIZE);
+
+    if (is->vis_mode == DII_VISUALIZATION_WAVEFORM) {
+        for (int x = 0, i = i_start; x < n; x++) {
+            int sum = 0;
+            for (int ch = 0; ch < channels; ch++) {
+                sum += is->sample_array[i];
+                if (++i >= SAMPLE_ARRAY_SIZE)
+                    i = 0;
+            }
+            is->vis_data[x] = sum / (32768.0f * channels);
+        }
+        is->vis_callback(is->vis_mode, is->vis_data, n);
+        return;
+    }
+
+    if (is->rdft_bits != VIS_RDFT_BITS) {
+        av_rdft_end(is->rdft);
+        av_freep(&is->rdft_data);
+        is->rdft = av_rdft_init(VIS_RDFT_BITS, DFT_R2C);
+        is->rdft_bits = VIS_RDFT_BITS;
+        is->rdft_data = (FFTSample *)av_malloc_array(n, sizeof(*is->rdft_data));
+    }
+    if (!is->rdft || !is->rdft_data)
+        return;
+    for (int x = 0, i = i_start; x < n; x++) {
+        int sum = 0;
+        for (int ch = 0; ch < channels; ch++) {
+            sum += is->sample_array[i];
+            if (++i >= SAMPLE_ARRAY_SIZE)
+                i = 0;
+        }
+        double w = (x - nb_freq) * (1.0 / nb_freq);
+        is->rdft_data[x] = sum / (32768.0f * channels) * (1.0 - w * w);
+    }
+    av_rdft_calc(is->rdft, is->rdft_data);
+    /* data[1] holds nyquist real part */
+    is->vis_data[0] = fabsf(is->rdft_data[0]) / nb_freq;
+    for (int y = 1; y < nb_freq; y++) {
+        float re = is->rdft_data[2 * y];
+        float im = is->rdft_data[2 * y + 1];
+        is->vis_data[y] = sqrtf(re * re + im * im) / nb_freq;
+    }
+    is->vis_callback(is->vis_mode, is->vis_data, nb_freq);
+}
+
 /* called to display each frame */
 static void video_refresh(void *opaque, double *remaining_time)
 {
@@ -1426,10 +1959,10 @@ static void video_refresh(void *opaque, double *remaining_time)
     if (!is->paused && get_master_sync_type(is) == AV_SYNC_EXTERNAL_CLOCK && is->realtime)
         check_external_clock_speed(is);
 
-    if (!display_disable && is->show_mode != SHOW_MODE_VIDEO && is->audio_st) {
+    if (!display_disable && is->vis_mode && is->audio_st && !is->paused) {
         time = av_gettime_relative() / 1000000.0;
         if (is->force_refresh || is->last_vis_time + rdftspeed < time) {
-            video_display(is);
+            audio_visualization_display(is);
             is->last_vis_time = time;
         }
         *remaining_time = FFMIN(*remaining_time, is->last_vis_time + rdftspeed - time);
@@ -1456,11 +1989,11 @@ static void video_refresh(void *opaque, double *remaining_time)
             if (lastvp->serial != vp->serial)
                 is->frame_timer = av_gettime_relative() / 1000000.0;
 
-            if (is->paused)
+            if (is->paused || is->is_buffering)
                 goto display;
 
-            /* compute nominal last_duration */
-            last_duration = vp_duration(is, lastvp, vp);
+            /* compute nominal last_duration, scaled by playback rate */
+            last_duration = vp_duration(is, lastvp, vp) / is->playback_rate;
             delay = compute_target_delay(last_duration, is);
 
             time= av_gettime_relative()/1000000.0;
@@ -1481,8 +2014,8 @@ static void video_refresh(void *opaque, double *remaining_time)
             // not for audio master
             if (frame_queue_nb_remaining(&is->pictq) > 1) {
                 Frame *nextvp = frame_queue_peek_next(&is->pictq);
-                duration = vp_duration(is, vp, nextvp);
-                if(!is->step && (framedrop>0 || (framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) && time > is->frame_timer + duration){
+                duration = vp_duration(is, vp, nextvp) / is->playback_rate;
+                if(!is->step && (is->opts.framedrop>0 || (is->opts.framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) && time > is->frame_timer + duration){
                     is->frame_drops_late++;
                     frame_queue_next(&is->pictq);
                     goto retry;
@@ -1570,12 +2103,85 @@ static int queue_picture(VideoState *is, AVFrame *src_frame, double pts, double
 
     av_frame_move_ref(vp->frame, src_frame);
     frame_queue_push(&is->pictq);
+    refresh_loop_wakeup(is);
     return 0;
 }
 
+static void set_decode_quality(VideoState *is, int quality)
+{
+    AVCodecContext *avctx = is->viddec.avctx;
+    int64_t now = av_gettime_relative();
+
+    // stepped up and had to come back soon, wait longer before next try
+    if (quality > is->vdec_quality && now - is->vdec_quality_time < is->vdec_up_hold)
+        is->vdec_up_hold = FFMIN(is->vdec_up_hold * 2, (int64_t)DECODE_QUALITY_UP_HOLD_MAX_US);
+
+    DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "video decode quality: " << is->vdec_quality << " -> " << quality
+                                                             << ", headroom: " << is->vdec_headroom << "%"
+                                                             << ", dropped: " << is->frame_drops_early + is->frame_drops_late;
+    avctx->skip_loop_filter = quality >= DECODE_QUALITY_SKIP_LOOP_FILTER ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+    avctx->skip_idct = quality >= DECODE_QUALITY_SKIP_IDCT ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    is->viddec.lowres_req = is->opts.lowres + (quality >= DECODE_QUALITY_LOWRES ? 1 : 0);
+    is->vdec_quality = quality;
+    is->vdec_quality_time = now;
+    is->vdec_quality_changes++;
+}
+
+/* compare decoder busy time with frame duration over a window, step quality down or up. */
+static void update_decode_quality(VideoState *is, enum AVDiscard skip_frame)
+{
+    int64_t now = av_gettime_relative();
+    int drops = is->frame_drops_early + is->frame_drops_late;
+
+    // pre-roll, fast rate, pause and stall are not steady playback load
+    if (skip_frame != AVDISCARD_DEFAULT || is->paused || is->is_buffering || !is->vdec_window_start) {
+        is->vdec_window_start = now;
+        is->vdec_frames = 0;
+        is->vdec_drops = drops;
+        is->viddec.busy_us = 0;
+        return;
+    }
+    if (now - is->vdec_window_start < DECODE_QUALITY_WINDOW_US || is->vdec_frames < DECODE_QUALITY_MIN_FRAMES)
+        return;
+
+    double budget = is->vdec_frames * is->vdec_frame_duration / is->playback_rate * 1000000;
+    int load = budget > 0 ? (int)(is->viddec.busy_us * 100 / budget) : 0;
+    int drop = (drops - is->vdec_drops) * 100 / is->vdec_frames;
+    is->vdec_headroom = FFMAX(0, 100 - load);
+    is->stat.decode_frame_count += is->vdec_frames;
+    is->stat.drop_frame_count = drops;
+    is->stat.drop_frame_rate = is->stat.decode_frame_count ? (float)drops / is->stat.decode_frame_count : 0;
+
+    if (is->opts.adaptive_decode) {
+        if ((load > DECODE_QUALITY_DOWN_LOAD || drop > DECODE_QUALITY_DOWN_DROPS) && is->vdec_quality < is->vdec_quality_max)
+            set_decode_quality(is, is->vdec_quality + 1);
+        else if (load < DECODE_QUALITY_UP_LOAD && !drop && is->vdec_quality > DECODE_QUALITY_FULL &&
+                 now - is->vdec_quality_time > is->vdec_up_hold)
+            set_decode_quality(is, is->vdec_quality - 1);
+    }
+
+    is->vdec_window_start = now;
+    is->vdec_frames = 0;
+    is->vdec_drops = drops;
+    is->viddec.busy_us = 0;
+}
+
 static int get_video_frame(VideoState *is, AVFrame *frame)
 {
     ffp_track_statistic_l(is, is->video_st, &is->videoq, &is->stat.video_cache);
+
+    // memory is tight, do not decode non-reference frames.
+    enum AVDiscard skip_frame = DiiMemoryBudget::Instance()->Pressure() >= DII_MEM_PRESSURE_DROP_NONREF ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    // accurate seek pre-roll, frames before target are not shown, only references are needed.
+    if (is->accurate_seek && is->seek_flag_video &&
+        (isnan(is->seek_decoded_pts) || is->seek_time - is->seek_decoded_pts > ACCURATE_SEEK_NONREF_MARGIN))
+        skip_frame = AVDISCARD_NONREF;
+    // high speed, do not spend decode time on frames mostly dropped.
+    if (is->playback_rate > PLAYBACK_RATE_SKIP_NONREF)
+        skip_frame = AVDISCARD_NONREF;
+    if (is->viddec.avctx->skip_frame != skip_frame)
+        is->viddec.avctx->skip_frame = skip_frame;
+    update_decode_quality(is, skip_frame);
     
     int got_picture;
     if ((got_picture = decoder_decode_frame(is, &is->viddec, frame, NULL)) < 0)
@@ -1583,13 +2189,14 @@ static int get_video_frame(VideoState *is, AVFrame *frame)
 
     if (got_picture) {
         double dpts = NAN;
+        is->vdec_frames++;
 
         if (frame->pts != AV_NOPTS_VALUE)
             dpts = av_q2d(is->video_st->time_base) * frame->pts;
 
         frame->sample_aspect_ratio = av_guess_sample_aspect_ratio(is->ic, is->video_st, frame);
 
-        if (framedrop>0 || (framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) {
+        if (is->opts.framedrop>0 || (is->opts.framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) {
             if (frame->pts != AV_NOPTS_VALUE) {
                 double diff = dpts - get_master_clock(is);
                 if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD &&
@@ -1916,6 +2523,7 @@ static int audio_thread(void *arg)
                 av_frame_move_ref(af->frame, frame);
                 // 解码后的音频帧缓存到队列
                 frame_queue_push(&is->sampq);
+                audio_ring_wakeup(&is->audio_ring);
 
 #if CONFIG_AVFILTER
                 if (is->audioq.serial != is->auddec.pkt_serial)
@@ -1952,6 +2560,7 @@ static int video_thread(void *arg)
     int ret;
     AVRational tb = is->video_st->time_base;
     AVRational frame_rate = av_guess_frame_rate(is->ic, is->video_st, NULL);
+    is->vdec_frame_duration = frame_rate.num && frame_rate.den ? av_q2d(/*(AVRational)*/{frame_rate.den, frame_rate.num}) : 0.04;
 
 #if CONFIG_AVFILTER
     AVFilterGraph *graph = avfilter_graph_alloc();
@@ -2042,6 +2651,7 @@ static int video_thread(void *arg)
                 is->seek_flag_video = 1;
                 
                 if (isnan(pts) || pts < is->seek_time) {
+                    is->seek_decoded_pts = pts;
                     continue;
                 } else {
                     is->seek_flag_video = 0;
@@ -2193,13 +2803,13 @@ static int audio_decode_frame(VideoState *is)
     int wanted_nb_samples;
     Frame *af;
 
-    if (is->paused)
+    if (is->paused || is->is_buffering)
         return -1;
 
     do {
 #if defined(_WIN32)
         while (frame_queue_nb_remaining(&is->sampq) == 0) {
-            if ((av_gettime_relative() - audio_callback_time) > 1000000LL * is->audio_hw_buf_size / is->audio_tgt.bytes_per_sec / 2)
+            if ((av_gettime_relative() - is->audio_callback_time) > 1000000LL * is->audio_hw_buf_size / is->audio_tgt.bytes_per_sec / 2)
                 return -1;
             av_usleep (1000);
         }
@@ -2311,7 +2921,130 @@ static int audio_decode_frame(VideoState *is)
     return resampled_data_size;
 }
 
-/* prepare a new audio buffer */
+/* decode audio and time stretch (pitch kept) by playback rate, return size of is->audio_buf */
+static int audio_decode_stretched(VideoState *is)
+{
+    if (is->playback_rate == 1.0) {
+        if (is->sound_touch && is->sound_touch->numSamples() + is->sound_touch->numUnprocessedSamples() > 0)
+            is->sound_touch->clear();
+        return audio_decode_frame(is);
+    }
+
+    int channels = is->audio_tgt.channels;
+    if (!is->sound_touch || is->sound_touch_freq != is->audio_tgt.freq || is->sound_touch_channels != channels) {
+        if (!is->sound_touch)
+            is->sound_touch = new dii_soundtouch::SoundTouch();
+        is->sound_touch->clear();
+        is->sound_touch->setSampleRate(is->audio_tgt.freq);
+        is->sound_touch->setChannels(channels);
+        is->sound_touch->setPitch(1.0);
+        is->sound_touch_freq = is->audio_tgt.freq;
+        is->sound_touch_channels = channels;
+    }
+    is->sound_touch->setTempo(is->playback_rate);
+
+    for (;;) {
+        int nb_samples = is->sound_touch->numSamples();
+        if (nb_samples > 0) {
+            av_fast_malloc(&is->audio_buf2, &is->audio_buf2_size, nb_samples * channels * sizeof(int16_t));
+            if (!is->audio_buf2)
+                return AVERROR(ENOMEM);
+            nb_samples = is->sound_touch->receiveSamples((dii_soundtouch::SAMPLETYPE *)is->audio_buf2, nb_samples);
+            is->audio_buf = is->audio_buf2;
+            return nb_samples * channels * sizeof(int16_t);
+        }
+
+        int audio_size = audio_decode_frame(is);
+        if (audio_size < 0)
+            return audio_size;
+        // seek, do not play stretched samples before it
+        if (is->audio_clock_serial != is->sound_touch_serial) {
+            is->sound_touch->clear();
+            is->sound_touch_serial = is->audio_clock_serial;
+        }
+        is->sound_touch->putSamples((dii_soundtouch::SAMPLETYPE *)is->audio_buf, audio_size / (channels * sizeof(int16_t)));
+    }
+}
+
+/* device format is applied on fill thread, resampler and time stretcher are only used there */
+static void audio_ring_set_format(VideoState *is, int freq, int channels)
+{
+    AudioRing *ring = &is->audio_ring;
+    is->audio_tgt.freq = freq;
+    is->audio_tgt.channels = channels;
+    is->audio_tgt.channel_layout = av_get_default_channel_layout(channels);
+    /* prepare audio output */
+    is->audio_tgt.fmt = AV_SAMPLE_FMT_S16;
+    is->audio_tgt.frame_size = av_samples_get_buffer_size(NULL, channels, 1, is->audio_tgt.fmt, 1);
+    is->audio_tgt.bytes_per_sec = av_samples_get_buffer_size(NULL, channels, freq, is->audio_tgt.fmt, 1);
+    // rebuild resampler by next frame
+    swr_free(&is->swr_ctx);
+    is->audio_src.freq = 0;
+
+    av_freep(&ring->data);
+    ring->size = is->audio_tgt.bytes_per_sec * AUDIO_RING_SIZE_MS / 1000 / is->audio_tgt.frame_size * is->audio_tgt.frame_size;
+    ring->target = is->audio_tgt.bytes_per_sec * ring->target_ms / 1000;
+    ring->refill = is->audio_tgt.bytes_per_sec * ring->refill_ms / 1000;
+    ring->data = (uint8_t *)av_malloc(ring->size);
+    audio_ring_flush(ring);
+    ring->freq = freq;
+    ring->channels = channels;
+    DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "audio output format: " << freq << " Hz, " << channels << " channels.";
+}
+
+/* decode, time stretch and resample ahead into audio ring */
+static void audio_fill_thread(VideoState *is)
+{
+    AudioRing *ring = &is->audio_ring;
+    int filling = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lck(*ring->mutex);
+            ring->cond->wait(lck, [ring, &filling] {
+                return ring->abort_request ||
+                    ring->want_freq != ring->freq || ring->want_channels != ring->channels ||
+                    (ring->data && ring->level < (filling ? ring->target : ring->refill));
+            });
+            if (ring->abort_request)
+                break;
+            if (ring->want_freq != ring->freq || ring->want_channels != ring->channels)
+                audio_ring_set_format(is, ring->want_freq, ring->want_channels);
+            if (!ring->data)
+                break;
+        }
+
+        filling = 1;
+        int audio_size = audio_decode_stretched(is);
+        if (audio_size < 0) {
+            filling = 0;
+            std::unique_lock<std::mutex> lck(*ring->mutex);
+            if (is->paused || is->is_buffering || frame_queue_nb_remaining(&is->sampq) <= 0) {
+                // paused, buffering or no frame yet, no wakeup until resume or next decoded frame
+                ring->cond->wait(lck, [is, ring] {
+                    return ring->abort_request ||
+                        ring->want_freq != ring->freq || ring->want_channels != ring->channels ||
+                        (!is->paused && !is->is_buffering && frame_queue_nb_remaining(&is->sampq) > 0);
+                });
+            } else if (!ring->abort_request) {
+                ring->cond->wait_for(lck, std::chrono::milliseconds(10));
+            }
+            continue;
+        }
+        if (is->vis_mode)
+            update_sample_display(is, (int16_t *)is->audio_buf, audio_size);
+
+        // samples still inside time stretcher are not in ring yet
+        double clock = is->audio_clock;
+        if (is->sound_touch && is->playback_rate != 1.0)
+            clock -= (is->sound_touch->numUnprocessedSamples() + is->sound_touch->numSamples() * is->playback_rate) / is->audio_tgt.freq;
+        int level = audio_ring_write(ring, is->audio_buf, audio_size, clock, is->audio_clock_serial,
+                                     is->audio_tgt.bytes_per_sec / is->playback_rate);
+        if (level >= ring->target)
+            filling = 0;
+    }
+}
+
+/* pull 10ms pcm from audio ring */
 int32_t dii_ffplay_need_10ms_pcm_data(void *opaque, uint8_t *stream, size_t sample_rate, size_t channel)
 {
     if(!opaque) return 0;
@@ -2321,78 +3054,47 @@ int32_t dii_ffplay_need_10ms_pcm_data(void *opaque, uint8_t *stream, size_t samp
     if(avctx == nullptr) {
         return 0;
     }
-   
-    if(is->audio_tgt.freq != (int)sample_rate ||
-       is->audio_tgt.channels != (int)channel ||
-       is->audio_tgt.fmt != AV_SAMPLE_FMT_S16) {
-        
-            is->audio_tgt.freq = (int)sample_rate;
-            is->audio_tgt.channels = (int)channel;
-            is->audio_tgt.channel_layout = av_get_default_channel_layout((int)channel);
-            /* prepare audio output */
-            is->audio_tgt.fmt = AV_SAMPLE_FMT_S16;
-            is->audio_tgt.frame_size = av_samples_get_buffer_size(NULL,
-                                                                  is->audio_tgt.channels,
-                                                                  1,
-                                                                  is->audio_tgt.fmt,
-                                                                  1);
-            is->audio_tgt.bytes_per_sec = av_samples_get_buffer_size(NULL,
-                                                                       is->audio_tgt.channels,
-                                                                       is->audio_tgt.freq,
-                                                                       is->audio_tgt.fmt,
-                                                                       1);
-    }
-    
+
     int bytes_per_sampele = 2;
     int32_t len_10ms = static_cast<int32_t>((float)sample_rate/100*channel*bytes_per_sampele);
+    int volume = is->muted ? 0 : is->audio_volume * 1024 / 100;
+    int len = 0;
+    is->audio_callback_time = av_gettime_relative();
 
-    int audio_size, len1;
-    audio_callback_time = av_gettime_relative();
-    int need_len = len_10ms;
-    while (need_len > 0) {
-        if (is->audio_buf_index >= is->audio_buf_size) {
-           audio_size = audio_decode_frame(is);
-           if (audio_size < 0) {
-                /* if error, just output silence */
-               is->audio_buf = NULL;
-               is->audio_buf_size = SDL_AUDIO_MIN_BUFFER_SIZE / is->audio_tgt.frame_size * is->audio_tgt.frame_size;
-           } else {
-               if (is->show_mode != SHOW_MODE_VIDEO)
-                   update_sample_display(is, (int16_t *)is->audio_buf, audio_size);
-               is->audio_buf_size = audio_size;
-           }
-           is->audio_buf_index = 0;
-        }
-        len1 = is->audio_buf_size - is->audio_buf_index;
-        if (len1 > need_len)
-            len1 = need_len;
-        if (!is->muted && is->audio_buf && is->audio_volume == 1024)
-            memcpy(stream, (uint8_t *)is->audio_buf + is->audio_buf_index, len1);
-        else {
-            memset(stream, 0, len1);
-            if (!is->muted && is->audio_buf) {
-                memcpy(stream, (uint8_t *)is->audio_buf + is->audio_buf_index, len1);
+    AudioRing *ring = &is->audio_ring;
+    {
+        std::unique_lock<std::mutex> lck(*ring->mutex);
+        bool wakeup = false;
+        if (ring->want_freq != (int)sample_rate || ring->want_channels != (int)channel) {
+            ring->want_freq = (int)sample_rate;
+            ring->want_channels = (int)channel;
+            wakeup = true;
+        } else if (ring->freq == (int)sample_rate && ring->channels == (int)channel) {
+            if (ring->serial != is->audioq.serial) {
+                audio_ring_flush(ring);
+                wakeup = true;
+            }
+            if (!is->paused && !is->is_buffering)
+                len = audio_ring_read(ring, stream, len_10ms, volume);
+
+            /* Let's assume the audio driver that is used by SDL has two periods. */
+            if (len > 0 && !isnan(ring->clock)) {
+                // output buffered plays at playback rate
+                double latency = (double)(2 * is->audio_hw_buf_size + ring->level) / is->audio_tgt.bytes_per_sec * is->playback_rate;
+                set_clock_at(&is->audclk, ring->clock - latency, ring->serial, is->audio_callback_time / 1000000.0);
+                sync_clock_to_slave(&is->extclk, &is->audclk);
             }
         }
-        need_len -= len1;
-        stream += len1;
-        is->audio_buf_index += len1;
-    }
-    
-    // if no stream only has audio, audio stream coming mean start complete
-//    if(!is->start_complete_ && is->video_st == nullptr) {
-//		if (is->state_callback) {
-//			is->state_callback(DII_STATE_PLAYING, '0', "playing");
-//		}
-//		is->start_complete_ = true;
-//    }
-    
-    is->audio_write_buf_size = is->audio_buf_size - is->audio_buf_index;
-    /* Let's assume the audio driver that is used by SDL has two periods. */
-    if (!isnan(is->audio_clock)) {
-        set_clock_at(&is->audclk, is->audio_clock - (double)(2 * is->audio_hw_buf_size + is->audio_write_buf_size) / is->audio_tgt.bytes_per_sec, is->audio_clock_serial, audio_callback_time / 1000000.0);
-        sync_clock_to_slave(&is->extclk, &is->audclk);		
+        // paused device keeps pulling, do not wake fill thread for nothing
+        if (wakeup || len > 0)
+            ring->cond->notify_all();
     }
+
+    /* if error, just output silence */
+    if (len < len_10ms)
+        memset(stream + len, 0, len_10ms - len);
+    if (len > 0 && !is->video_st)
+        mark_first_frame(is);
     
     return len_10ms;
 }
@@ -2409,7 +3111,7 @@ static int stream_component_open(VideoState *is, int stream_index)
     int sample_rate, nb_channels;
     int64_t channel_layout;
     int ret = 0;
-    int stream_lowres = lowres;
+    int stream_lowres = is->opts.lowres;
 
     if (stream_index < 0 || stream_index >= ic->nb_streams)
         return -1;
@@ -2459,11 +3161,13 @@ static int stream_component_open(VideoState *is, int stream_index)
     }
     avctx->lowres = stream_lowres;
 
-    if (fast)
+    if (is->opts.fast)
         avctx->flags2 |= AV_CODEC_FLAG2_FAST;
 
     //    opts = filter_codec_opts(codec_opts, avctx->codec_id, ic, ic->streams[stream_index], codec);
-    if (!av_dict_get(opts, "threads", NULL, 0))
+    if (is->opts.decoder_threads > 0)
+        av_dict_set_int(&opts, "threads", is->opts.decoder_threads, 0);
+    else if (!av_dict_get(opts, "threads", NULL, 0))
         av_dict_set(&opts, "threads", "auto", 0);
     if (stream_lowres)
         av_dict_set_int(&opts, "lowres", stream_lowres, 0);
@@ -2509,8 +3213,6 @@ static int stream_component_open(VideoState *is, int stream_index)
 
             is->audio_hw_buf_size = 1024;
             is->audio_src = is->audio_tgt;
-            is->audio_buf_size  = 0;
-            is->audio_buf_index = 0;
 
             /* init averaging filter */
             is->audio_diff_avg_coef  = exp(log(0.01) / AUDIO_DIFF_AVG_NB);
@@ -2531,11 +3233,18 @@ static int stream_component_open(VideoState *is, int stream_index)
             // 创建线程，并解码 
             if ((ret = decoder_start(&is->auddec, audio_thread, "audio_decoder", is)) < 0) //音频解码线程audio_thread
                 goto out1;
+            is->audio_fill_tid = new std::thread(audio_fill_thread, is);
             break;
         case AVMEDIA_TYPE_VIDEO:
             is->video_stream = stream_index;
             is->video_st = ic->streams[stream_index];
             decoder_init(&is->viddec, avctx, &is->videoq, is->continue_read_thread);
+            is->viddec.lowres_req = avctx->lowres;
+            // lowres step only for decoders supporting it (mpeg4, mjpeg...), not h264 / hevc
+            is->vdec_quality = DECODE_QUALITY_FULL;
+            is->vdec_quality_max = codec->max_lowres > stream_lowres ? DECODE_QUALITY_LOWRES : DECODE_QUALITY_SKIP_IDCT;
+            is->vdec_window_start = 0;
+            is->vdec_up_hold = DECODE_QUALITY_UP_HOLD_US;
             if ((ret = decoder_start(&is->viddec, video_thread, "video_decoder", is)) < 0)
                 goto out1;
             is->queue_attachments_req = 1;
@@ -2561,17 +3270,229 @@ out1:
     return ret;
 }
 
+static void set_thr_stat(VideoState *is, WorkStat stat)
+{
+    std::unique_lock<std::mutex> lck(*is->thr_stat_mutex);
+    is->thr_stat = stat;
+    is->thr_stat_cond->notify_all();
+}
+
+/* header of container already gives what decoders need, no need to probe packets. */
+static int stream_info_complete(AVFormatContext *ic)
+{
+    if ((ic->ctx_flags & AVFMTCTX_NOHEADER) || !ic->nb_streams || ic->duration == AV_NOPTS_VALUE)
+        return 0;
+    for (unsigned int i = 0; i < ic->nb_streams; i++) {
+        AVCodecParameters *par = ic->streams[i]->codecpar;
+        switch (par->codec_type) {
+        case AVMEDIA_TYPE_VIDEO:
+            if (par->codec_id == AV_CODEC_ID_NONE || par->width <= 0 || par->height <= 0)
+                return 0;
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            if (par->codec_id == AV_CODEC_ID_NONE || par->sample_rate <= 0 || par->channels <= 0)
+                return 0;
+            break;
+        default:
+            break;
+        }
+    }
+    return 1;
+}
+
+/* keep packets of the other audio tracks, so switch track needs no refill from demuxer. */
+static void audio_side_queue_open(VideoState *is)
+{
+    AVFormatContext *ic = is->ic;
+    int nb_audio = 0;
+
+    for (unsigned int i = 0; i < ic->nb_streams; i++) {
+        if (ic->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+            nb_audio++;
+    }
+    if (nb_audio < 2)
+        return;
+    is->audio_side_q = (PacketQueue *)av_mallocz_array(ic->nb_streams, sizeof(PacketQueue));
+    if (!is->audio_side_q)
+        return;
+    is->nb_audio_side_q = ic->nb_streams;
+    for (unsigned int i = 0; i < ic->nb_streams; i++) {
+        if (ic->streams[i]->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+            continue;
+        packet_queue_init(&is->audio_side_q[i]);
+        is->audio_side_q[i].abort_request = 0;
+        is->audio_side_q[i].mem_account = is->mem_account;
+        ic->streams[i]->discard = AVDISCARD_DEFAULT;
+    }
+    DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "audio track cache, tracks: " << nb_audio;
+}
+
+static void audio_side_queue_flush(VideoState *is)
+{
+    for (int i = 0; i < is->nb_audio_side_q; i++) {
+        if (is->audio_side_q[i].mutex)
+            packet_queue_flush(&is->audio_side_q[i]);
+    }
+}
+
+/* run on read thread, packets queued of the new track continue from audio clock. */
+static void audio_track_switch(VideoState *is, int stream_index)
+{
+    AVFormatContext *ic = is->ic;
+    int old_index = is->audio_stream;
+    double clock = get_clock(&is->audclk);
+    PacketQueue *side = NULL;
+
+    if (stream_index < 0 || stream_index >= (int)ic->nb_streams || stream_index == old_index ||
+        ic->streams[stream_index]->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+        return;
+    if (stream_index < is->nb_audio_side_q && is->audio_side_q[stream_index].mutex)
+        side = &is->audio_side_q[stream_index];
+
+    if (old_index >= 0) {
+        if (side) {
+            // not decoded packets of current track become its side queue
+            packet_queue_flush(&is->audio_side_q[old_index]);
+            packet_queue_move(&is->audio_side_q[old_index], &is->audioq);
+        }
+        stream_component_close(is, old_index);
+        if (side)
+            ic->streams[old_index]->discard = AVDISCARD_DEFAULT;
+    }
+    if (stream_component_open(is, stream_index) < 0) {
+        DII_LOG(LS_ERROR, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "open audio track failed, stream: " << stream_index;
+        return;
+    }
+    if (side) {
+        packet_queue_trim(side, ic->streams[stream_index]->time_base, clock, INT_MAX);
+        packet_queue_move(&is->audioq, side);
+        if (is->eof)
+            packet_queue_put_nullpacket(&is->audioq, stream_index);
+    }
+    DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "audio track: " << old_index << " -> " << stream_index
+                                                             << ", cached packets: " << is->audioq.nb_packets;
+}
+
+/* loop without draining decoders: seek demuxer back to start right at eof,
+ * the following packets are shifted by played length, decoders and clocks
+ * see one continuous stream. */
+static int gapless_loop_splice(VideoState *is, AVFormatContext *ic)
+{
+    if (!is->loop || !is->opts.gapless_loop || is->realtime || is->seek_by_bytes ||
+        is->loop_end_ts == AV_NOPTS_VALUE || (ic->iformat->flags & AVFMT_NOTIMESTAMPS) ||
+        (ic->pb && !(ic->pb->seekable & AVIO_SEEKABLE_NORMAL)))
+        return -1;
+
+    int64_t target = is->start_pos > 0 ? is->start_pos : 0;
+    int ret = avformat_seek_file(ic, -1, INT64_MIN, target, target, 0);
+    if (ret < 0) {
+        DII_LOG(LS_WARNING, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "gapless loop seek failed: " << ret;
+        return ret;
+    }
+
+    is->kf_last_ts = INT64_MIN;
+    is->loop_start_ts = FFMAX(target, ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0);
+    is->loop_duration = is->loop_end_ts - is->loop_start_ts;
+    is->loop_offset += is->loop_duration;
+    is->loop_end_ts = AV_NOPTS_VALUE;
+    is->loop_count++;
+    DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "gapless loop: " << is->loop_count
+        << ", duration: " << is->loop_duration / 1000 << " ms.";
+    return 0;
+}
+
 static int decode_interrupt_cb(void *ctx)
 {
     VideoState *is = (VideoState *)ctx;
     return is->abort_request;
 }
 
-static int stream_has_enough_packets(AVStream *st, int stream_id, PacketQueue *queue) {
+/* cached duration of packet queue, estimate by frame rate if packets carry no duration */
+static int64_t packet_queue_duration_ms(AVStream *st, PacketQueue *q) {
+    if (q->duration > 0 && st->time_base.num > 0 && st->time_base.den > 0)
+        return (int64_t)(q->duration * av_q2d(st->time_base) * 1000);
+    AVRational fr = st->avg_frame_rate;
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && fr.num > 0 && fr.den > 0)
+        return (int64_t)q->nb_packets * 1000 * fr.den / fr.num;
+    return (int64_t)q->nb_packets * 40;
+}
+
+static int stream_has_enough_packets(VideoState *is, AVStream *st, int stream_id, PacketQueue *queue) {
     return stream_id < 0 ||
     queue->abort_request ||
     (st->disposition & AV_DISPOSITION_ATTACHED_PIC) ||
-    ((queue->nb_packets > MIN_FRAMES) && (!queue->duration || av_q2d(st->time_base) * queue->duration > 1.0));
+    queue->nb_packets > MIN_FRAMES ||
+    packet_queue_duration_ms(st, queue) > is->buffer_read_ahead_ms;
+}
+
+static void toggle_buffering(VideoState* is, int start_buffering) {
+    double time = av_gettime_relative() / 1000000.0;
+    if (start_buffering) {
+        is->is_buffering = 1;
+        is->buffering_count++;
+        if (!is->paused) {
+            set_clock(&is->vidclk, get_clock(&is->vidclk), is->vidclk.serial);
+            set_clock(&is->audclk, get_clock(&is->audclk), is->audclk.serial);
+            set_clock(&is->extclk, get_clock(&is->extclk), is->extclk.serial);
+            is->audclk.paused = is->vidclk.paused = is->extclk.paused = 1;
+        }
+        DII_LOG(LS_INFO, is->ff_stream_id, 600020) << "ffplay toggle start buffering, count: " << is->buffering_count
+            << ", high watermark: " << is->buffer_high_ms << " ms.";
+        is->state_callback(DII_STATE_BUFFERING, 0, "buffering");
+    } else {
+        is->is_buffering = 0;
+        is->buffering_end_time = dii_rtc::TimeMillis();
+        if (!is->paused) {
+            is->frame_timer += time - is->vidclk.last_updated;
+            set_clock(&is->vidclk, get_clock(&is->vidclk), is->vidclk.serial);
+            set_clock(&is->audclk, get_clock(&is->audclk), is->audclk.serial);
+            set_clock(&is->extclk, get_clock(&is->extclk), is->extclk.serial);
+            is->audclk.paused = is->vidclk.paused = is->extclk.paused = 0;
+        }
+        DII_LOG(LS_INFO, is->ff_stream_id, 600022) << "ffplay toggle buffer ready.";
+        is->state_callback(DII_STATE_PLAYING, 0, "playing");
+        refresh_loop_wakeup(is);
+        audio_ring_wakeup(&is->audio_ring);
+    }
+}
+
+/* low watermark: pause clocks and buffering, high watermark: resume. */
+static void ffp_update_buffering(VideoState *is)
+{
+    if (!is->audio_st && !is->video_st)
+        return;
+
+    int64_t cached_ms = INT64_MAX;
+    if (is->audio_st)
+        cached_ms = FFMIN(cached_ms, packet_queue_duration_ms(is->audio_st, &is->audioq));
+    if (is->video_st && !(is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC))
+        cached_ms = FFMIN(cached_ms, packet_queue_duration_ms(is->video_st, &is->videoq));
+    is->cached_ms = (int)FFMIN(cached_ms, INT_MAX);
+    if (is->realtime)
+        return;
+
+    int64_t now = dii_rtc::TimeMillis();
+
+    if (!is->buffering_armed) {
+        if (is->eof || cached_ms >= is->buffer_high_ms)
+            is->buffering_armed = 1;
+        return;
+    }
+
+    if (is->is_buffering) {
+        if (is->eof || cached_ms >= is->buffer_high_ms)
+            toggle_buffering(is, 0);
+    } else if (!is->eof && !is->paused && !is->finished && cached_ms < BUFFERING_LOW_MS) {
+        // stall again soon, wait for more data before resume next time.
+        if (is->buffering_end_time && now - is->buffering_end_time < BUFFERING_STALL_WINDOW_MS) {
+            is->buffer_high_ms = FFMIN(is->buffer_high_ms * 2, BUFFERING_HIGH_MAX_MS);
+            is->buffer_read_ahead_ms = FFMAX(BUFFERING_READ_AHEAD_MS, is->buffer_high_ms * 2);
+        }
+        toggle_buffering(is, 1);
+    } else if (is->buffer_high_ms > BUFFERING_HIGH_MS && now - is->buffering_end_time > BUFFERING_DECAY_MS) {
+        is->buffer_high_ms = FFMAX(is->buffer_high_ms / 2, BUFFERING_HIGH_MS);
+        is->buffering_end_time = now;
+    }
 }
 
 static int is_realtime(AVFormatContext *s)
@@ -2592,16 +3513,9 @@ static int is_realtime(AVFormatContext *s)
 
 static void compute_accurate_seek_pos(VideoState* is, int64_t pos) {
     if(is->accurate_seek) {
-		int64_t adapt_pos = pos + milliseconds_to_fftime(2500);
-		int64_t tpos = pos;
-		if (pos > milliseconds_to_fftime(2500)) {
-			if (adapt_pos >= 0 ) {
-				adapt_pos = pos + milliseconds_to_fftime(2500);
-			}
-			tpos = adapt_pos;
-		}
-		//int64_t tpos = pos > milliseconds_to_fftime(2500) ? pos + milliseconds_to_fftime(3000) : pos;
-        is->seek_time =  tpos / 1000000.0;
+        // pos is the real target, keyframe before it is chosen by seek_keyframe
+        is->seek_time =  pos / 1000000.0;
+        is->seek_decoded_pts = NAN;
 		if(is->seek_forward) {
 			is->seek_flag_audio = 1;
 			is->seek_flag_video = 1;
@@ -2613,6 +3527,77 @@ static void compute_accurate_seek_pos(VideoState* is, int64_t pos) {
 		}
 	}
 }
+
+/* keyframe index of the main video stream, from disk cache or container index */
+static void keyframe_index_open(VideoState *is, AVFormatContext *ic)
+{
+    is->kf_stream = -1;
+    is->kf_last_ts = INT64_MIN;
+    if (ic->duration <= 0 || ic->duration == AV_NOPTS_VALUE)
+        return;
+
+    int index = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (index < 0)
+        return;
+
+    AVStream *st = ic->streams[index];
+    int64_t size = ic->pb ? avio_size(ic->pb) : -1;
+    is->kf_stream = index;
+    is->kf_index = new DiiKeyframeIndex(DiiKeyframeIndex::FileHash(is->filename, size, ic->duration));
+    if (is->kf_index->Load())
+        return;
+
+    // generic index is built while demuxing, not every keyframe is there.
+    bool full = !(ic->iformat->flags & AVFMT_GENERIC_INDEX);
+    AVRational time_base = { 1, AV_TIME_BASE };
+    int64_t prev = INT64_MIN;
+    for (int i = 0; i < st->nb_index_entries; i++) {
+        AVIndexEntry *e = &st->index_entries[i];
+        if (!(e->flags & AVINDEX_KEYFRAME) || e->timestamp == AV_NOPTS_VALUE)
+            continue;
+        int64_t ts = av_rescale_q(e->timestamp, st->time_base, time_base);
+        is->kf_index->AddKeyframe(full ? prev : INT64_MIN, ts);
+        prev = ts;
+    }
+    if (full && is->kf_index->Size() > 0)
+        is->kf_index->SetComplete(true);
+
+    DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "keyframe index: " << is->kf_index->Size()
+        << " keyframes, complete: " << is->kf_index->Complete();
+}
+
+static void keyframe_index_add(VideoState *is, AVPacket *pkt)
+{
+    if (!is->kf_index || pkt->stream_index != is->kf_stream || !(pkt->flags & AV_PKT_FLAG_KEY))
+        return;
+    int64_t ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+    if (ts == AV_NOPTS_VALUE)
+        return;
+    AVRational time_base = { 1, AV_TIME_BASE };
+    ts = av_rescale_q(ts, is->ic->streams[pkt->stream_index]->time_base, time_base);
+    is->kf_index->AddKeyframe(is->kf_last_ts, ts);
+    is->kf_last_ts = ts;
+}
+
+/* seek to the keyframe at or before target, fall back to the fixed 2.5s rewind without index */
+static int seek_keyframe(VideoState *is, AVFormatContext *ic, int64_t target, int64_t rel, int flags)
+{
+    int64_t keyframe_ts;
+    is->kf_last_ts = INT64_MIN;
+    if (!(flags & AVSEEK_FLAG_BYTE) && is->kf_index &&
+        is->kf_index->Lookup(target, KF_INDEX_MAX_PREROLL, &keyframe_ts)) {
+        DII_LOG(LS_INFO, is->ff_stream_id, 600006) << "seek to keyframe: " << keyframe_ts << ", target: " << target;
+        return avformat_seek_file(ic, -1, INT64_MIN, keyframe_ts, target, flags);
+    }
+
+    int64_t pos = (flags & AVSEEK_FLAG_BYTE) ? target : compute_seek_pos(is, target);
+    int64_t seek_min = rel > 0 ? pos - rel + 2: INT64_MIN;
+    int64_t seek_max = rel < 0 ? pos - rel - 2: INT64_MAX;
+    // FIXME the +-2 is due to rounding being not done in the correct direction in generation
+    //      of the seek_pos/seek_rel variables
+    return avformat_seek_file(ic, -1, seek_min, pos, seek_max, flags);
+}
+
 static int64_t dii_ffplay_duration(void *is);
 /* this thread gets the stream from the disk or the network */
 static int read_thread(void *arg)
@@ -2653,6 +3638,19 @@ static int read_thread(void *arg)
 
     av_dict_set(&opts, "rw_timeout", "3000*1000", 0);
     av_dict_set(&opts, "buffer_size", "1024*1000*10", 0); //设置缓存大小，1080p可将值调大
+    if (is->opts.probesize > 0)
+        av_dict_set_int(&opts, "probesize", is->opts.probesize, 0);
+    else if (is->opts.fast_open)
+        av_dict_set_int(&opts, "probesize", FAST_OPEN_PROBESIZE, 0);
+    if (is->opts.fast_open)
+        av_dict_set_int(&opts, "analyzeduration", FAST_OPEN_ANALYZEDURATION, 0);
+
+    // http vod read through disk cache
+    is->http_cache = DiiHttpCache::Open(is->filename, &ic->interrupt_callback, opts, is->ff_stream_id);
+    if (is->http_cache) {
+        ic->pb = is->http_cache->Context();
+        ic->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
 
     err = avformat_open_input(&ic, is->filename, is->iformat, &opts);
     if (err < 0) {
@@ -2665,32 +3663,39 @@ static int read_thread(void *arg)
     }
 
 	is->ic = ic;
-	is->thr_stat = WORK_OK;
+    is->open_time = (int)(dii_rtc::TimeMillis() - is->open_start_time);
 
-    if (genpts)
+    if (is->opts.genpts)
         ic->flags |= AVFMT_FLAG_GENPTS;
 
     av_format_inject_global_side_data(ic);
 
-    if (find_stream_info) {
+    if (find_stream_info && !(is->opts.fast_open && stream_info_complete(ic))) {
+        int64_t probe_start = dii_rtc::TimeMillis();
 
         err = avformat_find_stream_info(ic, NULL);
 
+        is->probe_time = (int)(dii_rtc::TimeMillis() - probe_start);
         if (err < 0) {
             DII_LOG(LS_WARNING, is->ff_stream_id, 600008) << is->filename << " could not find codec parameters.";
             ret = -1;
             goto fail;
         }
     }
+    DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "open input: " << is->open_time
+        << " ms, find stream info: " << is->probe_time << " ms, format: " << ic->iformat->name;
+	set_thr_stat(is, WORK_OK);
 
     if (ic->pb)
         ic->pb->eof_reached = 0; // FIXME hack, ffplay maybe should not use avio_feof() to test for the end
 
-    if (seek_by_bytes < 0)
-        seek_by_bytes = !!(ic->iformat->flags & AVFMT_TS_DISCONT) && strcmp("ogg", ic->iformat->name);
+    if (is->seek_by_bytes < 0)
+        is->seek_by_bytes = !!(ic->iformat->flags & AVFMT_TS_DISCONT) && strcmp("ogg", ic->iformat->name);
 
     is->max_frame_duration = (ic->iformat->flags & AVFMT_TS_DISCONT) ? 10.0 : 3600.0;
 
+    keyframe_index_open(is, ic);
+
     /* if seeking requested, we execute it */
     if (is->start_pos > 0) {
         int64_t timestamp;
@@ -2699,11 +3704,10 @@ static int read_thread(void *arg)
         /* add the stream start time */
         if (ic->start_time != AV_NOPTS_VALUE)
             timestamp += ic->start_time;
-        timestamp  = compute_seek_pos(is, timestamp);
         is->accurate_seek = 1;
         is->seek_forward = 1;
         compute_accurate_seek_pos(is, timestamp);
-        ret = avformat_seek_file(ic, -1, INT64_MIN, timestamp, INT64_MAX, 0);
+        ret = seek_keyframe(is, ic, timestamp, 0, 0);
         if (ret < 0) {
             DII_LOG(LS_WARNING, is->ff_stream_id, 600008) << is->filename << ": could not seek to position " << (double)timestamp / AV_TIME_BASE;
         }
@@ -2766,13 +3770,26 @@ static int read_thread(void *arg)
     if (st_index[AVMEDIA_TYPE_VIDEO] >= 0) {
         ret = stream_component_open(is, st_index[AVMEDIA_TYPE_VIDEO]);
     }
-    if (is->show_mode == SHOW_MODE_NONE)
-        is->show_mode = ret >= 0 ? SHOW_MODE_VIDEO : SHOW_MODE_RDFT;
+    // audio only: nothing to refresh without visualization, and device side buffers more.
+    if (is->show_mode == SHOW_MODE_NONE && ret >= 0)
+        is->show_mode = SHOW_MODE_VIDEO;
+    if (is->audio_stream >= 0 && ret < 0) {
+        std::unique_lock<std::mutex> lck(*is->audio_ring.mutex);
+        AudioRing *ring = &is->audio_ring;
+        ring->target_ms = AUDIO_ONLY_RING_TARGET_MS;
+        ring->refill_ms = AUDIO_ONLY_RING_REFILL_MS;
+        ring->target = is->audio_tgt.bytes_per_sec * ring->target_ms / 1000;
+        ring->refill = is->audio_tgt.bytes_per_sec * ring->refill_ms / 1000;
+        DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "audio only, visualization: " << is->vis_mode;
+    }
 
     if (st_index[AVMEDIA_TYPE_SUBTITLE] >= 0) {
         stream_component_open(is, st_index[AVMEDIA_TYPE_SUBTITLE]);
     }
 
+    if (is->opts.audio_track_cache && is->audio_stream >= 0)
+        audio_side_queue_open(is);
+
     if (is->video_stream < 0 && is->audio_stream < 0) {
         DII_LOG(LS_ERROR, is->ff_stream_id, 600008) << "Failed to open file:"<< is->filename << " or configure filtergraph.";
         is->state_callback(DII_STATE_ERROR, 600008, "Failed to open file or configure filtergraph.");
@@ -2780,8 +3797,16 @@ static int read_thread(void *arg)
         goto fail;
     }
 
-    if (infinite_buffer < 0 && is->realtime)
-        infinite_buffer = 1;
+    if (is->infinite_buffer < 0 && is->realtime)
+        is->infinite_buffer = 1;
+
+    // queue byte cap follows bitrate, room for read ahead duration with margin.
+    is->max_queue_bytes = MAX_QUEUE_SIZE;
+    if (ic->bit_rate > 0)
+        is->max_queue_bytes = (int)av_clip64(ic->bit_rate / 8 * BUFFERING_READ_AHEAD_MS * 3 / 2 / 1000,
+                                             MIN_QUEUE_SIZE, MAX_QUEUE_SIZE_LIMIT);
+    DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "bit rate: " << ic->bit_rate
+        << ", packet queue cap: " << is->max_queue_bytes << " bytes.";
 
     for (;;) {
         if (is->abort_request)
@@ -2806,12 +3831,8 @@ static int read_thread(void *arg)
         // seek处理
         if (is->seek_req) {
             int64_t seek_target = is->seek_pos;
-            int64_t seek_min    = is->seek_rel > 0 ? seek_target - is->seek_rel + 2: INT64_MIN;
-            int64_t seek_max    = is->seek_rel < 0 ? seek_target - is->seek_rel - 2: INT64_MAX;
-            // FIXME the +-2 is due to rounding being not done in the correct direction in generation
-            //      of the seek_pos/seek_rel variables
 
-            ret = avformat_seek_file(is->ic, -1, seek_min, seek_target, seek_max, is->seek_flags);
+            ret = seek_keyframe(is, is->ic, seek_target, is->seek_rel, is->seek_flags);
             if (ret < 0) {
                 DII_LOG(LS_ERROR, is->ff_stream_id, 600007) << is->ic->url << ": error while seeking."<<"whith error code: "<<ret;
                 is->state_callback(DII_STATE_ERROR, 600007, "error while seeking, url: %s");
@@ -2828,6 +3849,7 @@ static int read_thread(void *arg)
                     packet_queue_flush(&is->videoq);
                     packet_queue_put(&is->videoq, &flush_pkt);
                 }
+                audio_side_queue_flush(is);
                 if (is->seek_flags & AVSEEK_FLAG_BYTE) {
                     set_clock(&is->extclk, NAN, 0);
                 } else {
@@ -2838,12 +3860,23 @@ static int read_thread(void *arg)
             compute_accurate_seek_pos(is, is->seek_pos);
             
             is->seek_req = 0;
+            is->loop_offset = 0;
+            is->loop_end_ts = AV_NOPTS_VALUE;
+            // refill after seek is not a stall
+            if (is->is_buffering)
+                toggle_buffering(is, 0);
+            is->buffering_armed = 0;
             is->queue_attachments_req = 1;
             is->eof = 0;
             if (is->paused)
                 step_to_next_frame(is);
         }
 
+        if (is->audio_track_req >= 0) {
+            audio_track_switch(is, is->audio_track_req);
+            is->audio_track_req = -1;
+        }
+
         if (is->queue_attachments_req) {
             if (is->video_st && is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC) {
                 AVPacket copy = { 0 };
@@ -2858,12 +3891,21 @@ static int read_thread(void *arg)
             is->queue_attachments_req = 0;
         }
 
+        ffp_update_buffering(is);
+
         /* if the queue are full, no need to read more */
-        if (infinite_buffer<1 &&
-            (is->audioq.size + is->videoq.size + is->subtitleq.size > MAX_QUEUE_SIZE ||
-            (stream_has_enough_packets(is->audio_st, is->audio_stream, &is->audioq) &&
-            stream_has_enough_packets(is->video_st, is->video_stream, &is->videoq) &&
-            stream_has_enough_packets(is->subtitle_st, is->subtitle_stream, &is->subtitleq)))) {
+        // memory pressure: shrink queue limit, stop reading if still exhausted.
+        DiiMemoryPressure mem_pressure = DiiMemoryBudget::Instance()->Pressure();
+        int queue_size = is->audioq.size + is->videoq.size + is->subtitleq.size;
+        int max_queue_size = is->opts.max_queue_bytes > 0 ? is->opts.max_queue_bytes : is->max_queue_bytes;
+        if (mem_pressure >= DII_MEM_PRESSURE_SHRINK_CACHE)
+            max_queue_size /= 4;
+        if ((mem_pressure >= DII_MEM_PRESSURE_PAUSE_READ && queue_size > MAX_QUEUE_SIZE / 40) ||
+            (is->infinite_buffer<1 &&
+            (queue_size > max_queue_size ||
+            (stream_has_enough_packets(is, is->audio_st, is->audio_stream, &is->audioq) &&
+            stream_has_enough_packets(is, is->video_st, is->video_stream, &is->videoq) &&
+            stream_has_enough_packets(is, is->subtitle_st, is->subtitle_stream, &is->subtitleq))))) {
             std::unique_lock<std::mutex> lck(wait_mutex);
             is->continue_read_thread->wait_for(lck, std::chrono::milliseconds(10));
             continue;
@@ -2895,6 +3937,11 @@ static int read_thread(void *arg)
 
         if (ret < 0) { //错误或者结束，队列放入一个空包
             if ((ret == AVERROR_EOF || avio_feof(ic->pb)) && !is->eof) {
+                if (gapless_loop_splice(is, ic) >= 0) {
+                    if (ic->pb)
+                        ic->pb->eof_reached = 0;
+                    continue;
+                }
                 if (is->video_stream >= 0)
                     packet_queue_put_nullpacket(&is->videoq, is->video_stream);
                 if (is->audio_stream >= 0)
@@ -2931,8 +3978,32 @@ static int read_thread(void *arg)
         av_q2d(ic->streams[pkt->stream_index]->time_base) -
         (double)(is->start_pos > 0 ? is->start_pos : 0) / 1000000
         <= ((double)duration / 1000000);
+        keyframe_index_add(is, pkt);
+        if (pkt_in_play_range && pkt_ts != AV_NOPTS_VALUE) {
+            AVRational tb = ic->streams[pkt->stream_index]->time_base;
+            AVRational time_base = {1, AV_TIME_BASE};
+            int64_t end_ts = av_rescale_q(pkt_ts + FFMAX(pkt->duration, 0), tb, time_base);
+            if (is->loop_end_ts == AV_NOPTS_VALUE || end_ts > is->loop_end_ts)
+                is->loop_end_ts = end_ts;
+            if (is->loop_offset) {
+                int64_t offset = av_rescale_q(is->loop_offset, time_base, tb);
+                if (pkt->pts != AV_NOPTS_VALUE)
+                    pkt->pts += offset;
+                if (pkt->dts != AV_NOPTS_VALUE)
+                    pkt->dts += offset;
+            }
+        }
         if (pkt->stream_index == is->audio_stream && pkt_in_play_range) {
             packet_queue_put(&is->audioq, pkt);
+        } else if (pkt->stream_index < is->nb_audio_side_q && is->audio_side_q[pkt->stream_index].mutex && pkt_in_play_range) {
+            PacketQueue *side = &is->audio_side_q[pkt->stream_index];
+            packet_queue_put(side, pkt);
+            packet_queue_trim(side, ic->streams[pkt->stream_index]->time_base,
+                              get_clock(&is->audclk) - AUDIO_SIDE_QUEUE_BEHIND, AUDIO_SIDE_QUEUE_MAX_SIZE);
+        } else if (pkt->stream_index == is->video_stream && (pkt->flags & AV_PKT_FLAG_DISPOSABLE)
+                   && mem_pressure >= DII_MEM_PRESSURE_DROP_NONREF) {
+            is->mem_dropped_frames++;
+            av_packet_unref(pkt);
         } else if (pkt->stream_index == is->video_stream && pkt_in_play_range
                    && !(is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
             packet_queue_put(&is->videoq, pkt);
@@ -2949,13 +4020,14 @@ static int read_thread(void *arg)
     }
 
     ret = 0;
-	is->thr_stat = WORK_FINISH;
 fail:
+    set_thr_stat(is, WORK_FINISH);
     if (ic && !is->ic)
         avformat_close_input(&ic);
 
     if (ret != 0) {
         is->event_type = EVENT_TYPE_STOP;
+        refresh_loop_wakeup(is);
     }
     return 0;
 }
@@ -3041,18 +4113,33 @@ the_end:
 static void refresh_loop_wait_event(VideoState *is) {
     double remaining_time = 0.0;
     while (is->event_type == EVENT_TYPE_NONE) {
-        if (remaining_time > 0.0) {
-            std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(remaining_time*1000000.0)));
+        {
+            // INFINITY: nothing due, sleep until wakeup (paused, finished, no frame queued).
+            std::unique_lock<std::mutex> lck(*is->refresh_mutex);
+            auto woken = [is]() { return is->refresh_pending || is->event_type != EVENT_TYPE_NONE; };
+            if (isinf(remaining_time)) {
+                is->refresh_cond->wait(lck, woken);
+            } else if (remaining_time > 0.0) {
+                is->refresh_cond->wait_for(lck, std::chrono::microseconds((int64_t)(remaining_time*1000000.0)), woken);
+            }
+            is->refresh_pending = 0;
         }
+        if (is->event_type != EVENT_TYPE_NONE)
+            break;
 
-        if(is->paused || is->finished) {
+        remaining_time = INFINITY;
+        if (is->paused && (is->force_refresh || is->refresh_display)) {
             remaining_time = 5*REFRESH_RATE;
-        } else {
+        } else if (!is->paused && get_master_sync_type(is) == AV_SYNC_EXTERNAL_CLOCK && is->realtime) {
+            // external clock speed is adjusted in refresh
             remaining_time = REFRESH_RATE;
         }
-        
-        if (is->show_mode != SHOW_MODE_NONE && (!is->paused || is->force_refresh || is->refresh_display))
+
+        // audio only without visualization, this thread only waits for events
+        if ((is->show_mode != SHOW_MODE_NONE || is->vis_mode) && (!is->paused || is->force_refresh || is->refresh_display))
             video_refresh(is, &remaining_time);
+        else if (!is->paused && get_master_sync_type(is) == AV_SYNC_EXTERNAL_CLOCK && is->realtime)
+            check_external_clock_speed(is);
     }
 }
 
@@ -3107,7 +4194,7 @@ static void event_loop(VideoState *cur_stream)
             }else if (cur_stream->event_type == EVENT_TYPE_SEEKBACK) {
                 incr = -10;
             }
-            if (seek_by_bytes) {
+            if (cur_stream->seek_by_bytes) {
                 pos = -1;
                 if (pos < 0 && cur_stream->video_stream >= 0)
                     pos = frame_queue_last_pos(&cur_stream->pictq);
@@ -3145,8 +4232,10 @@ static VideoState *stream_open(const char *filename,
                                AVInputFormat *iformat,
                                int64_t pos,
                                int stream_id,
+                               const DiiFFPlayOptions *options,
                                VideoFrameCallback frame_callback,
-                               StateCallback state_callback)
+                               StateCallback state_callback,
+                               AudioVisualizationCallback vis_callback)
 {
     VideoState *is;
     is = (VideoState *)av_mallocz(sizeof(VideoState));
@@ -3156,9 +4245,26 @@ static VideoState *stream_open(const char *filename,
     
     ///
     is->ff_stream_id = stream_id;
+    is->opts = *options;
+    is->seek_by_bytes = -1;
+    is->infinite_buffer = options->infinite_buffer;
     is->finished = 0;
     is->frame_callback = frame_callback;
     is->state_callback = state_callback;
+    is->refresh_mutex = new std::mutex();
+    is->audio_ring.mutex = new std::mutex();
+    is->audio_ring.cond = new std::condition_variable();
+    is->audio_ring.target_ms = AUDIO_RING_TARGET_MS;
+    is->audio_ring.refill_ms = AUDIO_RING_TARGET_MS;
+    audio_ring_flush(&is->audio_ring);
+    is->vis_callback = vis_callback;
+    if (options->visualization != DII_VISUALIZATION_NONE && vis_callback) {
+        is->sample_array = (int16_t *)av_mallocz(SAMPLE_ARRAY_SIZE * sizeof(int16_t));
+        is->vis_data = (float *)av_mallocz(VIS_WAVE_SAMPLES * sizeof(float));
+        if (is->sample_array && is->vis_data)
+            is->vis_mode = options->visualization;
+    }
+    is->refresh_cond = new std::condition_variable();
     is->event_loop_thread = new std::thread(event_loop, is);
     
     ///
@@ -3194,6 +4300,15 @@ static VideoState *stream_open(const char *filename,
         goto fail;
     }
 
+    // all queues of this player charge to one memory account
+    is->mem_account = DiiMemoryBudget::Instance()->CreateAccount(is->ff_stream_id);
+    is->videoq.mem_account = is->mem_account;
+    is->audioq.mem_account = is->mem_account;
+    is->subtitleq.mem_account = is->mem_account;
+    is->pictq.mem_account = is->mem_account;
+    is->sampq.mem_account = is->mem_account;
+    is->subpq.mem_account = is->mem_account;
+
     if (!(is->continue_read_thread = new std::condition_variable())) {
         goto fail;
     }
@@ -3204,29 +4319,39 @@ static VideoState *stream_open(const char *filename,
     init_clock(&is->extclk, &is->extclk.serial);
     is->audio_clock_serial = -1;
     
-    if (startup_volume < 0) {
-        DII_LOG(LS_WARNING, is->ff_stream_id, DII_CODE_COMMON_WARN) << "-volume=" << startup_volume << " < 0, setting to 0.";
-    }
-    if (startup_volume > 100) {
-        DII_LOG(LS_WARNING, is->ff_stream_id, DII_CODE_COMMON_WARN) << "-volume=" << startup_volume << " > 100, setting to 100.";
-    }
-    startup_volume = av_clip(startup_volume, 0, 100);
-    is->audio_volume = startup_volume;
+    is->audio_volume = av_clip(startup_volume, 0, 100);
+    is->playback_rate = 1.0;
+    is->buffer_high_ms = BUFFERING_HIGH_MS;
+    is->buffer_read_ahead_ms = BUFFERING_READ_AHEAD_MS;
+    is->max_queue_bytes = MAX_QUEUE_SIZE;
+    is->loop_end_ts = AV_NOPTS_VALUE;
+    is->audio_track_req = -1;
     is->muted = 0;
-    // 音视频同步类型
-    is->av_sync_type = av_sync_type;
+    // 音视频同步类型, DiiSyncMaster 与 AV_SYNC_* 顺序一致
+    is->av_sync_type = options->sync_master;
 
+    is->thr_stat_mutex = new std::mutex();
+    is->thr_stat_cond = new std::condition_variable();
+    is->open_start_time = dii_rtc::TimeMillis();
     is->read_tid = new std::thread(read_thread, is);
     if(is->read_tid == nullptr) {
 fail:
+        is->event_type = EVENT_TYPE_STOP;
+        refresh_loop_wakeup(is);
+        if (is->event_loop_thread && is->event_loop_thread->joinable()) {
+            is->event_loop_thread->join();
+        }
+        delete is->event_loop_thread;
+        is->event_loop_thread = nullptr;
 		stream_close(is);
 		return NULL;
     }
 
-	int wait_ms = 0;
-	while (!is->thr_stat && wait_ms++ < 1000) {
-		std::this_thread::sleep_for(std::chrono::milliseconds(1));
-	}
+    // wait input opened (or failed), at most 1s
+    {
+        std::unique_lock<std::mutex> lck(*is->thr_stat_mutex);
+        is->thr_stat_cond->wait_for(lck, std::chrono::milliseconds(1000), [is] { return is->thr_stat != WORK_NONE; });
+    }
 
     return is;
 }
@@ -3262,6 +4387,12 @@ static int64_t dii_ffplay_position(void *is) {
         cur_pos = pos_clock * 1000;
     }
 
+    // gapless loop clock keeps growing, map back into the file
+    int64_t loop_start = fftime_to_milliseconds(vis->loop_start_ts);
+    int64_t loop_duration = fftime_to_milliseconds(vis->loop_duration);
+    if (loop_duration > 0 && cur_pos >= loop_start + loop_duration)
+        cur_pos = loop_start + (cur_pos - loop_start) % loop_duration;
+
     if (cur_pos < 0 || cur_pos < start_diff) return 0;
     
     int64_t pos = cur_pos - start_diff;
@@ -3310,6 +4441,7 @@ static int32_t dii_ffplay_stop(void *is) {
        return DII_PARAMETER_ERROR;
    
 	vis->event_type = EVENT_TYPE_STOP;
+    refresh_loop_wakeup(vis);
 	  
 	if (vis->event_loop_thread->joinable()) {
 		vis->event_loop_thread->join();
@@ -3361,6 +4493,38 @@ static int32_t dii_ffplay_seek(void *is, int64_t pos) {
        return 0;
 }
 
+static int32_t dii_ffplay_set_rate(void *is, double rate) {
+    VideoState *vis = (VideoState*)is;
+    if (!vis || rate < PLAYBACK_RATE_MIN || rate > PLAYBACK_RATE_MAX)
+        return DII_PARAMETER_ERROR;
+    if (vis->realtime)
+        return DII_ERROR;
+
+    vis->playback_rate = rate;
+    set_clock_speed(&vis->audclk, rate);
+    set_clock_speed(&vis->vidclk, rate);
+    set_clock_speed(&vis->extclk, rate);
+    DII_LOG(LS_INFO, vis->ff_stream_id, DII_CODE_COMMON_INFO) << "ffplay playback rate: " << rate;
+    return DII_DONE;
+}
+
+static int32_t dii_ffplay_select_audio_track(void *is, int32_t index) {
+    VideoState *vis = (VideoState*)is;
+    if (!vis || !vis->ic || index < 0)
+        return DII_PARAMETER_ERROR;
+
+    for (unsigned int i = 0, n = 0; i < vis->ic->nb_streams; i++) {
+        if (vis->ic->streams[i]->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+            continue;
+        if (n++ == (unsigned int)index) {
+            vis->audio_track_req = i;
+            vis->continue_read_thread->notify_one();
+            return DII_DONE;
+        }
+    }
+    return DII_PARAMETER_ERROR;
+}
+
 static bool dii_ffplay_loop(void *is, bool loop) {
 	VideoState *vis = (VideoState*)is;
 	if (!vis)
@@ -3380,15 +4544,19 @@ static bool dii_ffplay_loop(void *is, bool loop) {
 static void* dii_ffplay_start(const char* url,
                                 int64_t pos,
                                 int stream_id,
+                                const DiiFFPlayOptions *options,
                                 VideoFrameCallback frame_callback,
-                                StateCallback state_callback) {
+                                StateCallback state_callback,
+                                AudioVisualizationCallback vis_callback) {
     
     DII_LOG(LS_INFO, stream_id, 600001) <<  "ffplay start play url:" << url;
-    avformat_network_init();
-    av_init_packet(&flush_pkt);
-    flush_pkt.data = (uint8_t *)&flush_pkt;
+    std::call_once(flush_pkt_once, []() {
+        avformat_network_init();
+        av_init_packet(&flush_pkt);
+        flush_pkt.data = (uint8_t *)&flush_pkt;
+    });
 
-    VideoState *vis = stream_open(url, file_iformat, pos, stream_id, frame_callback, state_callback);
+    VideoState *vis = stream_open(url, file_iformat, pos, stream_id, options, frame_callback, state_callback, vis_callback);
     if (!vis) {
         DII_LOG(LS_ERROR, stream_id, 600009) << "Failed to initialize VideoState!";
         state_callback(DII_STATE_ERROR, 600009, "Failed to initialize VideoState!");
@@ -3402,8 +4570,9 @@ static void* dii_ffplay_start(const char* url,
 }
 
 namespace dii_media_kit  {
-    DiiFFPlayer::DiiFFPlayer(int32_t stream_id) {
+    DiiFFPlayer::DiiFFPlayer(int32_t stream_id, const DiiFFPlayOptions& options) {
         this->stream_id_ = stream_id;
+        this->options_ = options;
         
         _role = dii_radar::_Role_Unknown;
         _userid = NULL;
@@ -3424,8 +4593,10 @@ namespace dii_media_kit  {
         dii_ffplayer_ = dii_ffplay_start(url,
                                              pos,
                                              stream_id_,
+                                             &options_,
                                              callback_.video_frame_callback_,
-                                             callback_.state_callback_);
+                                             callback_.state_callback_,
+                                             callback_.audio_visualization_callback_);
         return 0;
     }
 
@@ -3467,6 +4638,24 @@ namespace dii_media_kit  {
         return ret;
     }
 
+    int32_t DiiFFPlayer::SetPlaybackRate(float rate) {
+        std::unique_lock<std::mutex> lck(mtx_);
+		int ret = -1;
+		if (dii_ffplayer_) {
+			ret = dii_ffplay_set_rate(dii_ffplayer_, rate);
+		}
+        return ret;
+    }
+
+    int32_t DiiFFPlayer::SelectAudioTrack(int32_t index) {
+        std::unique_lock<std::mutex> lck(mtx_);
+		int ret = -1;
+		if (dii_ffplayer_) {
+			ret = dii_ffplay_select_audio_track(dii_ffplayer_, index);
+		}
+        return ret;
+    }
+
     int32_t DiiFFPlayer::Seek(int64_t pos) {
         std::unique_lock<std::mutex> lck(mtx_);
 		int ret = -1;
@@ -3510,6 +4699,21 @@ namespace dii_media_kit  {
     }
 
     void DiiFFPlayer::DoStatistics(DiiPlayerStatistics& statistics) {
-        
+        std::unique_lock<std::mutex> lck(mtx_);
+        if (dii_ffplayer_) {
+            VideoState *is = (VideoState *)dii_ffplayer_;
+            statistics.memory_dropped_frames_ = is->mem_dropped_frames;
+            if (is->video_st) {
+                statistics.video_late_dropped_frames_ = is->frame_drops_early + is->frame_drops_late;
+                statistics.video_decode_headroom_ = is->vdec_headroom;
+                statistics.video_decode_quality_ = is->vdec_quality;
+                statistics.video_decode_quality_changes_ = is->vdec_quality_changes;
+            }
+            statistics.buffering_count_ = is->buffering_count;
+            statistics.cache_len_ = is->cached_ms;
+            statistics.open_time_ = is->open_time;
+            statistics.probe_time_ = is->probe_time;
+            statistics.first_frame_time_ = is->first_frame_time;
+        }
     }
 }
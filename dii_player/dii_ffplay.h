@@ -22,13 +22,15 @@ enum WorkStat {
 namespace dii_media_kit  {
     class DiiFFPlayer : public DiiPlayBase {
     public:
-        DiiFFPlayer(int32_t stream_id);
+        DiiFFPlayer(int32_t stream_id, const DiiFFPlayOptions& options);
         ~DiiFFPlayer();
         int32_t Start(const char* url, int64_t pos = 0, bool pause = false) override;
         int32_t Pause() override;
         int32_t Resume() override;
         int32_t StopPlay() override;
         int32_t SetLoop(bool loop) override;
+        int32_t SetPlaybackRate(float rate) override;
+        int32_t SelectAudioTrack(int32_t index) override;
         int32_t Seek(int64_t pos) override;
         int64_t Position() override;
         int64_t Duration() override;
@@ -40,6 +42,7 @@ namespace dii_media_kit  {
         void* dii_ffplayer_ = nullptr;
         DiiMediaBaseCallback callback_;
         int32_t stream_id_ = -1;
+        DiiFFPlayOptions options_;
         
         dii_radar::DiiRole _role;
         char * _userid;
@@ -0,0 +1,714 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_http_cache.h"
+#include "dii_media_utils.h"
+#include "webrtc/base/logging.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#if !defined(WEBRTC_WIN)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <linux/falloc.h>
+#endif
+#endif
+
+extern "C" {
+    #include "libavformat/avformat.h"
+    #include "libavformat/avio.h"
+    #include "libavutil/mem.h"
+    #include "libavutil/dict.h"
+}
+
+#define HTTP_CACHE_DEFAULT_CAPACITY (512 * 1024 * 1024LL)
+#define HTTP_CACHE_BLOCK_SIZE       (64 * 1024)
+#define HTTP_CACHE_IO_BUFFER_SIZE   (32 * 1024)
+#define HTTP_CACHE_PREFETCH_SIZE    (8 * 1024 * 1024)
+#define HTTP_CACHE_TRIM_INTERVAL    (4 * 1024 * 1024)
+#define HTTP_CACHE_MAP_MAGIC        0x4d434844      // "DHCM"
+#define HTTP_CACHE_MAP_VERSION      1
+
+namespace dii_media_kit {
+
+struct HttpCacheMapHeader {
+    uint32_t magic;
+    uint32_t version;
+    int64_t  file_size;
+    uint32_t block_size;
+    uint32_t block_count;
+};
+
+struct HttpCacheFileInfo {
+    std::string name;
+    int64_t     usage;
+    int64_t     mtime;
+};
+
+static uint64_t url_hash(const char* url) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const char* p = url; *p; p++) {
+        h ^= (uint8_t)*p;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static std::string cache_path(const std::string& dir, const std::string& name, const char* ext) {
+    std::string path = dir;
+    if (!path.empty() && path[path.size() - 1] != '/' && path[path.size() - 1] != '\\') {
+        path += "/";
+    }
+    return path + name + ext;
+}
+
+#if !defined(WEBRTC_WIN)
+static int open_cache_file(const std::string& path, int64_t size, uint8_t** map) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    // size changed, the remote file is not the one cached.
+    if (fstat(fd, &st) != 0 || (st.st_size != size && (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0))) {
+        close(fd);
+        return -1;
+    }
+    // read only map, blocks are written by pwrite: a full disk is an error, not SIGBUS.
+    void* addr = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    *map = (uint8_t*)addr;
+    return fd;
+}
+
+static void close_cache_file(int fd, uint8_t* map, int64_t size) {
+    if (map) {
+        munmap(map, (size_t)size);
+    }
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// return 0 if all written, or -errno, ENOSPC when disk is full.
+static int write_cache_block(int fd, int64_t offset, const uint8_t* data, int64_t len) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, (size_t)len, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (n == 0) {
+            return -ENOSPC;
+        }
+        data += n;
+        offset += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// give disk space of block back, sparse file keeps its size.
+static bool punch_hole(int fd, int64_t offset, int64_t len) {
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+    return fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, len) == 0;
+#elif defined(F_PUNCHHOLE)
+    struct fpunchhole args;
+    memset(&args, 0, sizeof(args));
+    args.fp_offset = offset;
+    args.fp_length = len;
+    return fcntl(fd, F_PUNCHHOLE, &args) == 0;
+#else
+    return false;
+#endif
+}
+
+static void touch_file(const std::string& path) {
+    utime(path.c_str(), NULL);
+}
+
+static void list_cache_files(const std::string& dir, std::vector<HttpCacheFileInfo>& files) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        return;
+    }
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL) {
+        std::string name = ent->d_name;
+        if (name.size() <= 4 || name.compare(name.size() - 4, 4, ".dhc") != 0) {
+            continue;
+        }
+        struct stat st;
+        name = name.substr(0, name.size() - 4);
+        if (stat(cache_path(dir, name, ".dhc").c_str(), &st) == 0) {
+            HttpCacheFileInfo info;
+            info.name = name;
+            info.usage = (int64_t)st.st_blocks * 512;
+            info.mtime = (int64_t)st.st_mtime;
+            files.push_back(info);
+        }
+    }
+    closedir(d);
+}
+#else
+static int open_cache_file(const std::string& path, int64_t size, uint8_t** map) {
+    return -1;
+}
+
+static void close_cache_file(int fd, uint8_t* map, int64_t size) {
+}
+
+static int write_cache_block(int fd, int64_t offset, const uint8_t* data, int64_t len) {
+    return -1;
+}
+
+static bool punch_hole(int fd, int64_t offset, int64_t len) {
+    return false;
+}
+
+static void touch_file(const std::string& path) {
+}
+
+static void list_cache_files(const std::string& dir, std::vector<HttpCacheFileInfo>& files) {
+}
+#endif
+
+DiiHttpCacheStore* DiiHttpCacheStore::http_cache_store_ins_ = nullptr;
+std::mutex* DiiHttpCacheStore::ins_mtx_ = new std::mutex();
+DiiHttpCacheStore* DiiHttpCacheStore::Instance() {
+    if (http_cache_store_ins_ == nullptr) {
+        ins_mtx_->lock();
+        if (http_cache_store_ins_ == nullptr) {
+            http_cache_store_ins_ = new DiiHttpCacheStore();
+        }
+        ins_mtx_->unlock();
+    }
+    return http_cache_store_ins_;
+}
+
+DiiHttpCacheStore::DiiHttpCacheStore()
+    : capacity_(HTTP_CACHE_DEFAULT_CAPACITY) {
+}
+
+void DiiHttpCacheStore::SetCapacity(int64_t bytes) {
+    LOG(LS_INFO) << "set http cache capacity: " << bytes << " bytes.";
+    capacity_ = bytes;
+}
+
+bool DiiHttpCacheStore::Acquire(const std::string& name) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    return in_use_.insert(name).second;
+}
+
+void DiiHttpCacheStore::Release(const std::string& name) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    in_use_.erase(name);
+}
+
+int64_t DiiHttpCacheStore::Trim(const std::string& dir) {
+    std::vector<HttpCacheFileInfo> files;
+    list_cache_files(dir, files);
+
+    int64_t total = 0;
+    for (auto& it : files) {
+        total += it.usage;
+    }
+    int64_t capacity = capacity_;
+    if (total <= capacity) {
+        return 0;
+    }
+
+    std::sort(files.begin(), files.end(), [](const HttpCacheFileInfo& a, const HttpCacheFileInfo& b) {
+        return a.mtime < b.mtime;
+    });
+    std::unique_lock<std::mutex> lck(mtx_);
+    for (auto& it : files) {
+        if (total <= capacity) {
+            break;
+        }
+        if (in_use_.count(it.name)) {
+            continue;
+        }
+        remove(cache_path(dir, it.name, ".dhc").c_str());
+        remove(cache_path(dir, it.name, ".dhm").c_str());
+        total -= it.usage;
+        LOG(LS_INFO) << "http cache evict file: " << it.name << ", bytes: " << it.usage;
+    }
+    return total > capacity ? total - capacity : 0;
+}
+
+DiiHttpCache* DiiHttpCache::Open(const char* url, const AVIOInterruptCB* int_cb, AVDictionary* opts, int32_t stream_id) {
+    if (!url || (strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0) || strstr(url, ".m3u8")) {
+        return NULL;
+    }
+    std::string dir = DiiUtil::Instance()->GetCacheDir();
+    if (dir.empty() || DiiHttpCacheStore::Instance()->Capacity() <= 0) {
+        return NULL;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)url_hash(url));
+    if (!DiiHttpCacheStore::Instance()->Acquire(name)) {
+        LOG(LS_WARNING) << "http cache is in use by another player, url: " << url;
+        return NULL;
+    }
+
+    DiiHttpCache* cache = new DiiHttpCache(stream_id, dir, name);
+    if (!cache->Init(url, int_cb, opts)) {
+        delete cache;
+        return NULL;
+    }
+    return cache;
+}
+
+DiiHttpCache::DiiHttpCache(int32_t stream_id, const std::string& dir, const std::string& name)
+    : stream_id_(stream_id)
+    , dir_(dir)
+    , name_(name)
+    , avio_(NULL)
+    , upstream_(NULL)
+    , int_cb_(NULL)
+    , parent_int_cb_(NULL)
+    , fd_(-1)
+    , map_(NULL)
+    , file_size_(0)
+    , pos_(0)
+    , tick_(0)
+    , cached_bytes_(0)
+    , read_pos_(0)
+    , physical_pos_(0)
+    , download_bytes_(0)
+    , hit_bytes_(0)
+    , written_since_trim_(0)
+    , prefetch_thread_(NULL)
+    , closing_(false)
+    , write_failed_(false) {
+}
+
+DiiHttpCache::~DiiHttpCache() {
+    closing_ = true;
+    cond_.notify_all();
+    if (prefetch_thread_) {
+        if (prefetch_thread_->joinable()) {
+            prefetch_thread_->join();
+        }
+        delete prefetch_thread_;
+        prefetch_thread_ = NULL;
+    }
+
+    if (upstream_) {
+        avio_closep(&upstream_);
+    }
+    if (avio_) {
+        av_freep(&avio_->buffer);
+        avio_context_free(&avio_);
+    }
+    if (map_) {
+        LOG(LS_INFO) << "http cache close, stream id: " << stream_id_ << ", file: " << name_
+                     << ", cached: " << cached_bytes_ << "/" << file_size_
+                     << ", download: " << download_bytes_ << ", hit: " << hit_bytes_;
+        close_cache_file(fd_, map_, file_size_);
+        SaveBlockMap();
+        touch_file(cache_path(dir_, name_, ".dhc"));
+    } else if (fd_ >= 0) {
+        close_cache_file(fd_, NULL, 0);
+    }
+    delete int_cb_;
+    delete parent_int_cb_;
+    DiiHttpCacheStore::Instance()->Release(name_);
+}
+
+bool DiiHttpCache::Init(const char* url, const AVIOInterruptCB* int_cb, AVDictionary* opts) {
+    parent_int_cb_ = new AVIOInterruptCB();
+    if (int_cb) {
+        *parent_int_cb_ = *int_cb;
+    }
+    int_cb_ = new AVIOInterruptCB();
+    int_cb_->callback = InterruptCallback;
+    int_cb_->opaque = this;
+
+    AVDictionary* io_opts = NULL;
+    av_dict_copy(&io_opts, opts, 0);
+    int err = avio_open2(&upstream_, url, AVIO_FLAG_READ, int_cb_, &io_opts);
+    av_dict_free(&io_opts);
+    if (err < 0) {
+        // let avformat_open_input report the error.
+        return false;
+    }
+
+    // live or chunked response, nothing to cache.
+    file_size_ = avio_size(upstream_);
+    if (file_size_ <= 0 || !(upstream_->seekable & AVIO_SEEKABLE_NORMAL) || (uint64_t)file_size_ > SIZE_MAX / 2) {
+        LOG(LS_INFO) << "http cache disabled, size: " << file_size_ << ", url: " << url;
+        return false;
+    }
+    if (!MapFile()) {
+        LOG(LS_WARNING) << "http cache can not map file: " << cache_path(dir_, name_, ".dhc");
+        return false;
+    }
+
+    uint8_t* buffer = (uint8_t*)av_malloc(HTTP_CACHE_IO_BUFFER_SIZE);
+    if (buffer) {
+        avio_ = avio_alloc_context(buffer, HTTP_CACHE_IO_BUFFER_SIZE, 0, this, ReadPacket, NULL, SeekPacket);
+    }
+    if (!avio_) {
+        av_free(buffer);
+        return false;
+    }
+    avio_->seekable = AVIO_SEEKABLE_NORMAL;
+
+    LOG(LS_INFO) << "http cache open, stream id: " << stream_id_ << ", file: " << name_
+                 << ", size: " << file_size_ << ", cached: " << cached_bytes_;
+    prefetch_thread_ = new std::thread(&DiiHttpCache::PrefetchLoop, this);
+    return true;
+}
+
+bool DiiHttpCache::MapFile() {
+    int64_t blocks = (file_size_ + HTTP_CACHE_BLOCK_SIZE - 1) / HTTP_CACHE_BLOCK_SIZE;
+    present_.assign((size_t)blocks, 0);
+    last_use_.assign((size_t)blocks, 0);
+
+    LoadBlockMap();
+    fd_ = open_cache_file(cache_path(dir_, name_, ".dhc"), file_size_, &map_);
+    if (fd_ < 0) {
+        return false;
+    }
+    return true;
+}
+
+void DiiHttpCache::LoadBlockMap() {
+    std::string path = cache_path(dir_, name_, ".dhm");
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return;
+    }
+    HttpCacheMapHeader header;
+    std::vector<uint8_t> present;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1
+              && header.magic == HTTP_CACHE_MAP_MAGIC
+              && header.version == HTTP_CACHE_MAP_VERSION
+              && header.file_size == file_size_
+              && header.block_size == HTTP_CACHE_BLOCK_SIZE
+              && header.block_count == present_.size();
+    if (ok) {
+        present.resize(header.block_count);
+        ok = fread(&present[0], 1, present.size(), fp) == present.size();
+    }
+    fclose(fp);
+    // map is written back on close, a crash never leave blocks not flushed marked.
+    remove(path.c_str());
+    if (!ok) {
+        return;
+    }
+    present_.swap(present);
+    for (size_t i = 0; i < present_.size(); i++) {
+        if (present_[i]) {
+            cached_bytes_ += BlockLength(i);
+        }
+    }
+}
+
+void DiiHttpCache::SaveBlockMap() {
+    if (cached_bytes_ <= 0) {
+        return;
+    }
+    std::string path = cache_path(dir_, name_, ".dhm");
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        return;
+    }
+    HttpCacheMapHeader header;
+    header.magic = HTTP_CACHE_MAP_MAGIC;
+    header.version = HTTP_CACHE_MAP_VERSION;
+    header.file_size = file_size_;
+    header.block_size = HTTP_CACHE_BLOCK_SIZE;
+    header.block_count = (uint32_t)present_.size();
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+              && fwrite(&present_[0], 1, present_.size(), fp) == present_.size();
+    if (fclose(fp) != 0 || !ok) {
+        remove(path.c_str());
+    }
+}
+
+int64_t DiiHttpCache::BlockLength(int64_t idx) {
+    return std::min<int64_t>(HTTP_CACHE_BLOCK_SIZE, file_size_ - idx * HTTP_CACHE_BLOCK_SIZE);
+}
+
+int DiiHttpCache::Read(uint8_t* buf, int size) {
+    if (pos_ >= file_size_) {
+        return AVERROR_EOF;
+    }
+    int64_t idx = pos_ / HTTP_CACHE_BLOCK_SIZE;
+    bool hit = true;
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        read_pos_ = pos_;
+        hit = present_[idx] != 0;
+    }
+    cond_.notify_all();
+
+    std::unique_lock<std::mutex> lck(mtx_);
+    // fetch again if evicted just after fetch.
+    while (!present_[idx]) {
+        lck.unlock();
+        int ret = write_failed_ ? -1 : FetchBlock(idx);
+        if (ret < 0) {
+            // cache file not writable (disk full), read around it.
+            return write_failed_ ? ReadUncached(buf, size) : ret;
+        }
+        lck.lock();
+    }
+    int64_t block_end = std::min<int64_t>((idx + 1) * HTTP_CACHE_BLOCK_SIZE, file_size_);
+    int len = (int)std::min<int64_t>(size, block_end - pos_);
+    memcpy(buf, map_ + pos_, len);
+    last_use_[idx] = ++tick_;
+    if (hit) {
+        hit_bytes_ += len;
+    }
+    pos_ += len;
+    read_pos_ = pos_;
+    return len;
+}
+
+int64_t DiiHttpCache::Seek(int64_t offset, int whence) {
+    int64_t pos;
+    switch (whence & ~AVSEEK_FORCE) {
+        case AVSEEK_SIZE:
+            return file_size_;
+        case SEEK_SET:
+            pos = offset;
+            break;
+        case SEEK_CUR:
+            pos = pos_ + offset;
+            break;
+        case SEEK_END:
+            pos = file_size_ + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+    if (pos < 0) {
+        return AVERROR(EINVAL);
+    }
+    pos_ = pos;
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        read_pos_ = pos_;
+    }
+    cond_.notify_all();
+    return pos_;
+}
+
+int DiiHttpCache::FetchBlock(int64_t idx) {
+    std::unique_lock<std::mutex> io_lck(io_mtx_);
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        if (present_[idx]) {
+            return 0;
+        }
+    }
+
+    int64_t start = idx * HTTP_CACHE_BLOCK_SIZE;
+    int64_t len = BlockLength(idx);
+    if (avio_tell(upstream_) != start) {
+        int64_t ret = avio_seek(upstream_, start, SEEK_SET);
+        if (ret < 0) {
+            LOG(LS_WARNING) << "http cache seek upstream failed: " << start << ", err: " << ret;
+            return (int)ret;
+        }
+    }
+
+    // block is not marked, no reader touch it before write finish.
+    block_buf_.resize(HTTP_CACHE_BLOCK_SIZE);
+    int64_t got = 0;
+    while (got < len) {
+        int ret = avio_read(upstream_, &block_buf_[0] + got, (int)(len - got));
+        if (ret <= 0) {
+            return ret < 0 ? ret : AVERROR_EOF;
+        }
+        got += ret;
+    }
+    int err = write_cache_block(fd_, start, &block_buf_[0], len);
+    if (err < 0) {
+        LOG(LS_WARNING) << "http cache write failed, stream id: " << stream_id_ << ", err: " << err
+                        << ", read without cache from now on.";
+        write_failed_ = true;
+        cond_.notify_all();
+        return AVERROR(EIO);
+    }
+
+    bool trim = false;
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        present_[idx] = 1;
+        last_use_[idx] = ++tick_;
+        cached_bytes_ += len;
+        download_bytes_ += len;
+        physical_pos_ = start + len;
+        written_since_trim_ += len;
+        if (written_since_trim_ >= HTTP_CACHE_TRIM_INTERVAL) {
+            written_since_trim_ = 0;
+            trim = true;
+        }
+    }
+
+    if (trim) {
+        int64_t over = DiiHttpCacheStore::Instance()->Trim(dir_);
+        if (over > 0) {
+            EvictBlocks(over);
+        }
+    }
+    return 0;
+}
+
+// cache file not writable, demux reads upstream directly.
+int DiiHttpCache::ReadUncached(uint8_t* buf, int size) {
+    std::unique_lock<std::mutex> io_lck(io_mtx_);
+    if (avio_tell(upstream_) != pos_) {
+        int64_t ret = avio_seek(upstream_, pos_, SEEK_SET);
+        if (ret < 0) {
+            return (int)ret;
+        }
+    }
+    int ret = avio_read(upstream_, buf, (int)std::min<int64_t>(size, file_size_ - pos_));
+    if (ret <= 0) {
+        return ret < 0 ? ret : AVERROR_EOF;
+    }
+    pos_ += ret;
+    std::unique_lock<std::mutex> lck(mtx_);
+    read_pos_ = pos_;
+    physical_pos_ = pos_;
+    download_bytes_ += ret;
+    return ret;
+}
+
+void DiiHttpCache::EvictBlocks(int64_t bytes) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    std::vector<std::pair<uint32_t, size_t> > blocks;
+    for (size_t i = 0; i < present_.size(); i++) {
+        if (present_[i]) {
+            blocks.push_back(std::make_pair(last_use_[i], i));
+        }
+    }
+    std::sort(blocks.begin(), blocks.end());
+
+    // never evict what to be read soon.
+    int64_t keep_from = read_pos_ / HTTP_CACHE_BLOCK_SIZE;
+    int64_t keep_to = (read_pos_ + HTTP_CACHE_PREFETCH_SIZE) / HTTP_CACHE_BLOCK_SIZE;
+    int64_t evicted = 0;
+    for (auto& it : blocks) {
+        if (evicted >= bytes) {
+            break;
+        }
+        int64_t idx = it.second;
+        if (idx >= keep_from && idx <= keep_to) {
+            continue;
+        }
+        int64_t len = BlockLength(idx);
+        punch_hole(fd_, idx * HTTP_CACHE_BLOCK_SIZE, len);
+        present_[idx] = 0;
+        cached_bytes_ -= len;
+        evicted += len;
+    }
+    LOG(LS_INFO) << "http cache evict blocks, stream id: " << stream_id_ << ", bytes: " << evicted;
+}
+
+void DiiHttpCache::PrefetchLoop() {
+    while (!closing_) {
+        int64_t next = -1;
+        {
+            std::unique_lock<std::mutex> lck(mtx_);
+            int64_t from = read_pos_ / HTTP_CACHE_BLOCK_SIZE;
+            int64_t to = std::min<int64_t>((read_pos_ + HTTP_CACHE_PREFETCH_SIZE) / HTTP_CACHE_BLOCK_SIZE,
+                                           (int64_t)present_.size() - 1);
+            for (int64_t i = from; i <= to; i++) {
+                if (!present_[i]) {
+                    next = i;
+                    break;
+                }
+            }
+            if (next < 0 || write_failed_) {
+                cond_.wait_for(lck, std::chrono::milliseconds(100));
+                continue;
+            }
+        }
+
+        int ret = FetchBlock(next);
+        if (ret < 0 && !closing_) {
+            // network error, demux thread will report it, retry later.
+            std::unique_lock<std::mutex> lck(mtx_);
+            cond_.wait_for(lck, std::chrono::milliseconds(500));
+        }
+    }
+}
+
+void DiiHttpCache::GetStatistic(Statistic* st) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    st->file_size = file_size_;
+    st->read_pos = read_pos_;
+    st->physical_pos = physical_pos_;
+    st->cached_bytes = cached_bytes_;
+    st->download_bytes = download_bytes_;
+    st->hit_bytes = hit_bytes_;
+    st->prefetch_window = HTTP_CACHE_PREFETCH_SIZE;
+
+    int64_t idx = read_pos_ / HTTP_CACHE_BLOCK_SIZE;
+    int64_t end = idx;
+    while (end < (int64_t)present_.size() && present_[end]) {
+        end++;
+    }
+    st->forwards = std::max<int64_t>(0, std::min(end * HTTP_CACHE_BLOCK_SIZE, file_size_) - read_pos_);
+    int64_t begin = idx;
+    while (begin > 0 && present_[begin - 1]) {
+        begin--;
+    }
+    st->backwards = std::max<int64_t>(0, read_pos_ - begin * HTTP_CACHE_BLOCK_SIZE);
+}
+
+int DiiHttpCache::ReadPacket(void* opaque, uint8_t* buf, int size) {
+    return ((DiiHttpCache*)opaque)->Read(buf, size);
+}
+
+int64_t DiiHttpCache::SeekPacket(void* opaque, int64_t offset, int whence) {
+    return ((DiiHttpCache*)opaque)->Seek(offset, whence);
+}
+
+int DiiHttpCache::InterruptCallback(void* opaque) {
+    DiiHttpCache* cache = (DiiHttpCache*)opaque;
+    if (cache->closing_) {
+        return 1;
+    }
+    AVIOInterruptCB* parent = cache->parent_int_cb_;
+    return parent && parent->callback ? parent->callback(parent->opaque) : 0;
+}
+
+}	// namespace dii_media_kit
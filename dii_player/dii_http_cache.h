@@ -0,0 +1,144 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_HTTP_CACHE_H__
+#define __DII_HTTP_CACHE_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+struct AVIOContext;
+struct AVIOInterruptCB;
+struct AVDictionary;
+
+namespace dii_media_kit {
+
+/* Disk usage of all http cache files under DiiMediaKit::SetCacheDir,
+ * least recently used files are removed when over capacity.
+ */
+class DiiHttpCacheStore {
+public:
+    static DiiHttpCacheStore* Instance();
+
+    void SetCapacity(int64_t bytes);
+    int64_t Capacity() { return capacity_; }
+
+    // one cache file can be used by one player at the same time.
+    bool Acquire(const std::string& name);
+    void Release(const std::string& name);
+
+    // remove closed files, return bytes still over capacity.
+    int64_t Trim(const std::string& dir);
+
+private:
+    DiiHttpCacheStore();
+    static std::mutex* ins_mtx_;
+    static DiiHttpCacheStore* http_cache_store_ins_;
+
+    std::mutex              mtx_;
+    std::atomic<int64_t>    capacity_;
+    std::set<std::string>   in_use_;
+};
+
+/* Read through cache of a http(s) VOD source for avformat.
+ * Downloaded ranges are kept in a sparse mmap'd file with a block map,
+ * a prefetch thread reads ahead of the demuxer position.
+ */
+class DiiHttpCache {
+public:
+    struct Statistic {
+        int64_t file_size;
+        int64_t read_pos;       // demuxer position
+        int64_t physical_pos;   // network position
+        int64_t forwards;       // cached bytes continuous after read_pos
+        int64_t backwards;      // cached bytes continuous before read_pos
+        int64_t cached_bytes;
+        int64_t download_bytes;
+        int64_t hit_bytes;      // bytes read from cache without waiting network
+        int64_t prefetch_window;
+    };
+
+    // NULL if url can not be cached: not http, unknown size or no cache dir.
+    static DiiHttpCache* Open(const char* url, const AVIOInterruptCB* int_cb, AVDictionary* opts, int32_t stream_id);
+    ~DiiHttpCache();
+
+    // custom io for AVFormatContext.pb, owned by cache.
+    AVIOContext* Context() { return avio_; }
+    void GetStatistic(Statistic* st);
+
+private:
+    DiiHttpCache(int32_t stream_id, const std::string& dir, const std::string& name);
+    bool Init(const char* url, const AVIOInterruptCB* int_cb, AVDictionary* opts);
+    bool MapFile();
+    void LoadBlockMap();
+    void SaveBlockMap();
+
+    int Read(uint8_t* buf, int size);
+    int64_t Seek(int64_t offset, int whence);
+    int FetchBlock(int64_t idx);
+    int ReadUncached(uint8_t* buf, int size);
+    void EvictBlocks(int64_t bytes);
+    void PrefetchLoop();
+    int64_t BlockLength(int64_t idx);
+
+    static int ReadPacket(void* opaque, uint8_t* buf, int size);
+    static int64_t SeekPacket(void* opaque, int64_t offset, int whence);
+    static int InterruptCallback(void* opaque);
+
+private:
+    int32_t                 stream_id_;
+    std::string             dir_;
+    std::string             name_;
+    AVIOContext*            avio_;
+    AVIOContext*            upstream_;
+    AVIOInterruptCB*        int_cb_;
+    AVIOInterruptCB*        parent_int_cb_;
+
+    int                     fd_;
+    uint8_t*                map_;
+    int64_t                 file_size_;
+    int64_t                 pos_;           // only used by demux thread
+
+    std::mutex              mtx_;           // block map
+    std::mutex              io_mtx_;        // upstream
+    std::condition_variable cond_;
+    std::vector<uint8_t>    present_;
+    std::vector<uint32_t>   last_use_;      // lru tick of block
+    uint32_t                tick_;
+    int64_t                 cached_bytes_;
+    int64_t                 read_pos_;
+    int64_t                 physical_pos_;
+    int64_t                 download_bytes_;
+    int64_t                 hit_bytes_;
+    int64_t                 written_since_trim_;
+    std::vector<uint8_t>    block_buf_;     // fetched block before written, guarded by io_mtx_
+
+    std::thread*            prefetch_thread_;
+    std::atomic<bool>       closing_;
+    std::atomic<bool>       write_failed_;  // disk full, stop caching
+};
+
+}	// namespace dii_media_kit
+
+#endif	// __DII_HTTP_CACHE_H__
@@ -0,0 +1,240 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_keyframe_index.h"
+#include "dii_media_utils.h"
+#include "webrtc/base/logging.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define KF_INDEX_MAGIC      0x49464b44      // "DKFI"
+#define KF_INDEX_VERSION    2
+#define KF_INDEX_MAX_SIZE   (1024 * 1024)
+
+namespace dii_media_kit {
+
+// file layout: header | int64_t ts[count] | uint8_t linked[count],
+// entries are not written as structs so no padding reaches the disk.
+struct KeyframeIndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash;
+    uint32_t complete;
+    uint32_t count;
+};
+
+static uint64_t fnv1a(uint64_t h, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+DiiKeyframeIndex::DiiKeyframeIndex(uint64_t file_hash)
+    : hash_(file_hash)
+    , complete_(false)
+    , dirty_(false) {
+}
+
+DiiKeyframeIndex::~DiiKeyframeIndex() {
+}
+
+uint64_t DiiKeyframeIndex::FileHash(const char* url, int64_t file_size, int64_t duration) {
+    uint64_t h = 14695981039346656037ULL;
+    if (url) {
+        h = fnv1a(h, url, strlen(url));
+    }
+    h = fnv1a(h, &file_size, sizeof(file_size));
+    h = fnv1a(h, &duration, sizeof(duration));
+    return h;
+}
+
+std::string DiiKeyframeIndex::CachePath() {
+    std::string dir = DiiUtil::Instance()->GetCacheDir();
+    if (dir.empty()) {
+        return "";
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.kfi", (unsigned long long)hash_);
+    if (dir[dir.size() - 1] != '/' && dir[dir.size() - 1] != '\\') {
+        dir += "/";
+    }
+    return dir + name;
+}
+
+bool DiiKeyframeIndex::Load() {
+    std::string path = CachePath();
+    if (path.empty()) {
+        return false;
+    }
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+
+    KeyframeIndexHeader header;
+    std::vector<Entry> entries;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1
+              && header.magic == KF_INDEX_MAGIC
+              && header.version == KF_INDEX_VERSION
+              && header.hash == hash_
+              && header.count <= KF_INDEX_MAX_SIZE;
+    if (ok && header.count > 0) {
+        std::vector<int64_t> ts(header.count);
+        std::vector<uint8_t> linked(header.count);
+        ok = fread(&ts[0], sizeof(int64_t), header.count, fp) == header.count
+             && fread(&linked[0], sizeof(uint8_t), header.count, fp) == header.count;
+        if (ok) {
+            entries.resize(header.count);
+            for (uint32_t i = 0; i < header.count; i++) {
+                entries[i].ts = ts[i];
+                entries[i].linked = linked[i] != 0;
+            }
+        }
+    }
+    fclose(fp);
+    if (!ok) {
+        LOG(LS_WARNING) << "invalid keyframe index cache: " << path;
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lck(mtx_);
+    entries_.swap(entries);
+    complete_ = header.complete != 0;
+    dirty_ = false;
+    LOG(LS_INFO) << "load keyframe index: " << path << ", keyframes: " << entries_.size();
+    return true;
+}
+
+bool DiiKeyframeIndex::Save() {
+    std::unique_lock<std::mutex> lck(mtx_);
+    if (!dirty_ || entries_.empty()) {
+        return true;
+    }
+    std::string path = CachePath();
+    if (path.empty()) {
+        return false;
+    }
+
+    // write to temp file then rename, never leave a half written index.
+    std::string tmp = path + ".tmp";
+    FILE* fp = fopen(tmp.c_str(), "wb");
+    if (!fp) {
+        LOG(LS_WARNING) << "can not write keyframe index cache: " << tmp;
+        return false;
+    }
+    KeyframeIndexHeader header;
+    header.magic = KF_INDEX_MAGIC;
+    header.version = KF_INDEX_VERSION;
+    header.hash = hash_;
+    header.complete = complete_ ? 1 : 0;
+    header.count = (uint32_t)entries_.size();
+    std::vector<int64_t> ts(entries_.size());
+    std::vector<uint8_t> linked(entries_.size());
+    for (size_t i = 0; i < entries_.size(); i++) {
+        ts[i] = entries_[i].ts;
+        linked[i] = entries_[i].linked ? 1 : 0;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+              && fwrite(&ts[0], sizeof(int64_t), ts.size(), fp) == ts.size()
+              && fwrite(&linked[0], sizeof(uint8_t), linked.size(), fp) == linked.size();
+    ok = fclose(fp) == 0 && ok;
+    remove(path.c_str());
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+    dirty_ = false;
+    return true;
+}
+
+void DiiKeyframeIndex::SetComplete(bool complete) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    if (complete_ != complete) {
+        complete_ = complete;
+        dirty_ = true;
+    }
+}
+
+bool DiiKeyframeIndex::Complete() {
+    std::unique_lock<std::mutex> lck(mtx_);
+    return complete_;
+}
+
+size_t DiiKeyframeIndex::LowerBound(int64_t ts) {
+    size_t lo = 0, hi = entries_.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (entries_[mid].ts < ts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void DiiKeyframeIndex::AddKeyframe(int64_t prev_ts, int64_t ts) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    size_t pos = LowerBound(ts);
+    if (pos == entries_.size() || entries_[pos].ts != ts) {
+        if (complete_ || entries_.size() >= KF_INDEX_MAX_SIZE) {
+            return;
+        }
+        Entry entry;
+        entry.ts = ts;
+        entry.linked = false;
+        entries_.insert(entries_.begin() + pos, entry);
+        dirty_ = true;
+    }
+
+    if (prev_ts != INT64_MIN && pos > 0 && entries_[pos - 1].ts == prev_ts && !entries_[pos - 1].linked) {
+        entries_[pos - 1].linked = true;
+        dirty_ = true;
+    }
+}
+
+bool DiiKeyframeIndex::Lookup(int64_t target, int64_t max_preroll, int64_t* keyframe_ts) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    size_t pos = LowerBound(target);
+    if (pos < entries_.size() && entries_[pos].ts == target) {
+        pos++;
+    }
+    if (pos == 0) {
+        return false;
+    }
+
+    // a keyframe we have not seen may lie between entry and target,
+    // only trust it when the gap is known or short enough to decode.
+    const Entry& entry = entries_[pos - 1];
+    if (!complete_ && !entry.linked && target - entry.ts > max_preroll) {
+        return false;
+    }
+    *keyframe_ts = entry.ts;
+    return true;
+}
+
+size_t DiiKeyframeIndex::Size() {
+    std::unique_lock<std::mutex> lck(mtx_);
+    return entries_.size();
+}
+
+}	// namespace dii_media_kit
@@ -0,0 +1,73 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_KEYFRAME_INDEX_H__
+#define __DII_KEYFRAME_INDEX_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+
+namespace dii_media_kit {
+
+/* Sorted keyframe timestamps (us, AV_TIME_BASE) of one media file.
+ * Filled from container index, or lazily from demuxed keyframes, and
+ * cached on disk under DiiMediaKit::SetCacheDir by file hash.
+ */
+class DiiKeyframeIndex {
+public:
+    explicit DiiKeyframeIndex(uint64_t file_hash);
+    ~DiiKeyframeIndex();
+
+    // fingerprint of file: url, size and duration.
+    static uint64_t FileHash(const char* url, int64_t file_size, int64_t duration);
+
+    bool Load();
+    bool Save();
+
+    // index from container, every keyframe is known.
+    void SetComplete(bool complete);
+    bool Complete();
+
+    // prev_ts is the keyframe demuxed right before ts, INT64_MIN if none (after seek).
+    void AddKeyframe(int64_t prev_ts, int64_t ts);
+
+    // nearest keyframe <= target, false if index can not tell.
+    bool Lookup(int64_t target, int64_t max_preroll, int64_t* keyframe_ts);
+    size_t Size();
+
+private:
+    struct Entry {
+        int64_t ts;
+        bool    linked;     // next entry is the next keyframe in file
+    };
+    std::string CachePath();
+    size_t LowerBound(int64_t ts);
+
+private:
+    std::mutex          mtx_;
+    uint64_t            hash_;
+    std::vector<Entry>  entries_;
+    bool                complete_;
+    bool                dirty_;
+};
+
+}	// namespace dii_media_kit
+
+#endif	// __DII_KEYFRAME_INDEX_H__
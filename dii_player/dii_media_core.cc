@@ -10,15 +10,17 @@
 #include "dii_common.h"
 #include "dii_ffplay.h"
 #include "dii_rtmp/dii_rtmp_player.h"
+#include "dii_memory_budget.h"
+#include "dii_worker_pool.h"
 #include "webrtc/video_frame.h"
 #include "webrtc/media/engine/webrtcvideoframe.h"
 #include "webrtc/common_video/libyuv/include/webrtc_libyuv.h"
 #include "third_party/libyuv/include/libyuv.h"
 
 #include <regex>
+#include <algorithm>
 
 // dii message
-#define DII_MSG_TICKTACK              8001
 #define DII_MSG_FINISH                1000
 #define DII_MSG_START                 1001
 #define DII_MSG_PAUSE                 1002
@@ -26,6 +28,16 @@
 #define DII_MSG_STOP                  1004
 #define DII_MSG_SEEK                  1005
 #define DII_MSG_LOOP                  1006
+#define DII_MSG_RATE                  1007
+#define DII_MSG_AUDIO_TRACK           1008
+#define DII_MSG_STATISTICS            1009
+
+// frames from this size are scaled / converted by row bands on worker pool
+#define DII_PARALLEL_CONVERT_PIXELS   (1920 * 1080)
+#define DII_CONVERT_BAND_MIN_ROWS     64
+// async delivery, frame waited longer than this in queue is counted late
+#define DII_DELIVERY_LATE_MS          50
+#define DII_DELIVERY_QUEUE_MAX        16
 
 namespace dii_media_kit  {
 DiiMediaCore::DiiMediaCore(void* render, bool outputPcmForExternalMix) {
@@ -40,7 +52,9 @@ DiiMediaCore::DiiMediaCore(void* render, bool outputPcmForExternalMix) {
     _report = true;
     
     dii_rtc::Thread::Start();
-    dii_rtc::Thread::PostDelayed(RTC_FROM_HERE, 1000, this, DII_MSG_TICKTACK);
+    // statistics of all players are done in one pass of timer wheel.
+    timer_wheel_ = DiiTimerWheel::GetInstance();
+    timer_wheel_->AddTicker(this, [this]() { this->DoStatistics(); });
 }
 
 DiiMediaCore::~DiiMediaCore() {
@@ -49,9 +63,10 @@ DiiMediaCore::~DiiMediaCore() {
         this->StopPlay();
     }
     /* wait all msg handle down.*/
-    dii_rtc::Thread::Clear(this, DII_MSG_TICKTACK);
+    timer_wheel_->RemoveTicker(this);
     
     dii_rtc::Thread::Stop();
+    this->SetAsyncVideoDelivery(0);
 	if (video_render_) {
 		delete video_render_;
 		video_render_ = nullptr;
@@ -97,6 +112,8 @@ void DiiMediaCore::OnMessage(dii_rtc::Message* msg) {
             static_cast<dii_rtc::TypedMessageData<std::string>*>(msg->pdata);
             player_ = CreatePlayer(data->data().c_str());
             player_->Start(data->data().c_str(), this->play_pos_);
+            if (!real_stream_ && playback_rate_ != 1.0f)
+                player_->SetPlaybackRate(playback_rate_);
             this->StartAudioPlayout();
             break;
         } case DII_MSG_PAUSE : {
@@ -113,6 +130,16 @@ void DiiMediaCore::OnMessage(dii_rtc::Message* msg) {
             if(player_)
                 player_->SetLoop(loop_);
             break;
+        } case DII_MSG_RATE: {
+            if(player_)
+                player_->SetPlaybackRate(playback_rate_);
+            break;
+        } case DII_MSG_AUDIO_TRACK: {
+            dii_rtc::TypedMessageData<int32_t>* data =
+                static_cast<dii_rtc::TypedMessageData<int32_t>*>(msg->pdata);
+            if(player_)
+                player_->SelectAudioTrack(data->data());
+            break;
         } case DII_MSG_STOP: {
             this->StopAudioPlayout();
             std::unique_lock<std::mutex> lck(mtx_);
@@ -121,6 +148,15 @@ void DiiMediaCore::OnMessage(dii_rtc::Message* msg) {
                 delete player_;
                 player_ = nullptr;
             }
+            {
+                std::unique_lock<std::mutex> delivery_lck(delivery_mtx_);
+                delivery_queue_.clear();
+            }
+            // next play delivers frames on another thread, retained buffers stay alive by ref
+            {
+                std::unique_lock<std::mutex> size_lck(set_video_size_mtx_);
+                scale_buffer_pool_.Release();
+            }
             break;
         } case DII_MSG_SEEK : {
             dii_rtc::TypedMessageData<int64_t>* data =
@@ -128,13 +164,15 @@ void DiiMediaCore::OnMessage(dii_rtc::Message* msg) {
             if(player_)
                 player_->Seek(data->data());
             break;
+        } case DII_MSG_STATISTICS: {
+            dii_rtc::TypedMessageData<DiiPlayerStatistics>* data =
+                static_cast<dii_rtc::TypedMessageData<DiiPlayerStatistics>*>(msg->pdata);
+            this->ReportStatistics(data->data());
+            break;
         } case DII_MSG_FINISH: {
             // when stream finish, must stop audio playout, otherwise there will be some noise.
             this->StopAudioPlayout();
             break;
-        } case DII_MSG_TICKTACK: {
-            this->DoStatistics();
-            break;
         } default: {
             break;
         }
@@ -165,7 +203,7 @@ DiiPlayBase* DiiMediaCore::CreatePlayer(std::string url) {
         << ", url: " << url;
         
         real_stream_ = false;
-        player = new DiiFFPlayer(stream_id_);
+        player = new DiiFFPlayer(stream_id_, ffplay_options_);
     }
     DiiMediaBaseCallback callbacks;
     callbacks.state_callback_ = std::bind(&DiiMediaCore::OnPlayerState,
@@ -181,6 +219,15 @@ DiiPlayBase* DiiMediaCore::CreatePlayer(std::string url) {
     callbacks.rtmp_sync_time_callback_ = std::bind(&DiiMediaCore::OnStreamSyncTime,
                                                    this,
                                                    std::placeholders::_1);
+
+    // visualization is computed only when someone consumes it
+    if(callback_.visualization_callback) {
+        callbacks.audio_visualization_callback_ = std::bind(&DiiMediaCore::OnAudioVisualization,
+                                                            this,
+                                                            std::placeholders::_1,
+                                                            std::placeholders::_2,
+                                                            std::placeholders::_3);
+    }
     player->SetCallback(callbacks);
     return player;
 }
@@ -208,6 +255,11 @@ int32_t DiiMediaCore::Start(int32_t stream_id, const char* url, int64_t pos, boo
     // must reset some member var.
     frame_width_  = 0;
     frame_height_ = 0;
+    {
+        std::unique_lock<std::mutex> lck(delivery_mtx_);
+        delivery_dropped_frames_ = 0;
+        delivery_late_frames_ = 0;
+    }
     
     dii_rtc::Thread::Post(RTC_FROM_HERE, this, DII_MSG_START, new dii_rtc::TypedMessageData<std::string>(url));
     
@@ -243,6 +295,37 @@ int32_t DiiMediaCore::SetLoop(bool loop) {
     return DII_DONE;
 }
 
+int32_t DiiMediaCore::SetPlaybackRate(float rate) {
+    if (rate < 0.5f || rate > 3.0f) {
+        return DII_PARAMETER_ERROR;
+    }
+    if (started_ && real_stream_) {
+        return DII_ERROR;
+    }
+    playback_rate_ = rate;
+    if (started_) {
+        dii_rtc::Thread::Post(RTC_FROM_HERE, this, DII_MSG_RATE);
+    }
+    return DII_DONE;
+}
+
+int32_t DiiMediaCore::SelectAudioTrack(int32_t index) {
+    if(!started_ || real_stream_) {
+        return DII_ERROR;
+    }
+    if(index < 0) {
+        return DII_PARAMETER_ERROR;
+    }
+    dii_rtc::Thread::Post(RTC_FROM_HERE, this, DII_MSG_AUDIO_TRACK, new dii_rtc::TypedMessageData<int32_t>(index));
+    return DII_DONE;
+}
+
+int32_t DiiMediaCore::SetFFPlayOptions(const DiiFFPlayOptions& options) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    ffplay_options_ = options;
+    return DII_DONE;
+}
+
 int32_t DiiMediaCore::StopPlay() {
     if(!started_) {
         return DII_DONE;
@@ -336,45 +419,81 @@ void DiiMediaCore::OnPlayerState(int state, int code, const char* msg) {
 }
 
 void DiiMediaCore::DoStatistics() {
-    dii_rtc::Thread::PostDelayed(RTC_FROM_HERE, 1000, this, DII_MSG_TICKTACK);
-    // realtime stream statistics
-    if(player_ && real_stream_) {
+    // called on timer wheel thread, shared by all players, never block here.
+    {
+        std::unique_lock<std::mutex> lck(mtx_, std::try_to_lock);
+        if(!lck.owns_lock() || !player_)
+            return;
         statistics_.stream_id = stream_id_;
         player_->DoStatistics(statistics_);
-		statistics_.start_to_render_time_ = start_to_render_time_;
+    }
+    statistics_.start_to_render_time_ = start_to_render_time_;
+    {
+        // set_video_size_mtx_ is held across conversion and app callback, don't wait it here.
+        int64_t convert_time_us = convert_time_us_.exchange(0);
+        int32_t convert_frames = convert_frames_.exchange(0);
+        statistics_.video_convert_time_us_ = convert_frames > 0 ? (int32_t)(convert_time_us / convert_frames) : 0;
+    }
+    {
+        std::unique_lock<std::mutex> lck(delivery_mtx_);
+        statistics_.video_delivery_dropped_frames_ = delivery_dropped_frames_;
+        statistics_.video_delivery_late_frames_ = delivery_late_frames_;
+    }
+
+    // memory budget, shared by realtime stream and file player.
+    statistics_.memory_bytes_       = DiiMemoryBudget::Instance()->StreamUsage(stream_id_);
+    statistics_.memory_total_bytes_ = DiiMemoryBudget::Instance()->TotalUsage();
+    statistics_.memory_pressure_    = DiiMemoryBudget::Instance()->Pressure();
+
+    // listeners are called on player thread.
+    dii_rtc::Thread::Post(RTC_FROM_HERE, this, DII_MSG_STATISTICS,
+                          new dii_rtc::TypedMessageData<DiiPlayerStatistics>(statistics_));
+}
+
+void DiiMediaCore::ReportStatistics(DiiPlayerStatistics& statistics) {
+    // realtime stream statistics
+    if(real_stream_) {
         DII_LOG(LS_INFO, stream_id_, 0)
                     << "dii player statistics"
-                    << ", stream id: "              << statistics_.stream_id
-                    << ", video render framerate: " << statistics_.video_render_framerate
-                    << ", video decode framerate: " << statistics_.video_decode_framerate
-                    << ", video width: "            << statistics_.video_width_
-                    << ", video height: "           << statistics_.video_height_
-                    << ", audio samplerate: "       << statistics_.audio_samplerate_
-                    << ", play cache len: "         << statistics_.cache_len_
-                    << ", audio bps: "              << statistics_.audio_bps_
-                    << ", video bps: "              << statistics_.video_bps_ ;
-        
-        if(callback_.statistics_callback)
-            callback_.statistics_callback(statistics_);
-        
-        if(_report){
-            // callback to extern statistics callback
-            dii_media_kit::DiiUtil::Instance()->ExternalStatisticsCallback(statistics_);
-        }
-        
-        // if video stream and audio stream bps not 0, we think have video or audio;
-        bool has_video = statistics_.video_bps_ > 0;
-        bool has_audio = statistics_.audio_bps_ > 0;
-        
-        if(has_audio && DiiUnixTimestampMs() - last_play_audio_frame_ts_ > 10*1000) {
-           last_play_audio_frame_ts_ = DiiUnixTimestampMs();
-           DII_LOG(LS_ERROR, stream_id_, 2002015) << "no audio packet played for more than 10 seconds.";
-        }
-           
-        if(has_video && DiiUnixTimestampMs() - last_render_video_frame_ts_  > 10*1000) {
-           last_render_video_frame_ts_ = DiiUnixTimestampMs();
-           DII_LOG(LS_ERROR, stream_id_, 2002016) << "no video frame render for more than 10 seconds.";
-        }
+                    << ", stream id: "              << statistics.stream_id
+                    << ", video render framerate: " << statistics.video_render_framerate
+                    << ", video decode framerate: " << statistics.video_decode_framerate
+                    << ", video late dropped: "     << statistics.video_late_dropped_frames_
+                    << ", video decode headroom: "  << statistics.video_decode_headroom_
+                    << ", video width: "            << statistics.video_width_
+                    << ", video height: "           << statistics.video_height_
+                    << ", audio samplerate: "       << statistics.audio_samplerate_
+                    << ", play cache len: "         << statistics.cache_len_
+                    << ", audio bps: "              << statistics.audio_bps_
+                    << ", video bps: "              << statistics.video_bps_
+                    << ", memory bytes: "           << statistics.memory_bytes_
+                    << ", memory pressure: "        << statistics.memory_pressure_;
+    }
+
+    if(callback_.statistics_callback)
+        callback_.statistics_callback(statistics);
+
+    if(!real_stream_) {
+        return;
+    }
+
+    if(_report){
+        // callback to extern statistics callback
+        dii_media_kit::DiiUtil::Instance()->ExternalStatisticsCallback(statistics);
+    }
+    
+    // if video stream and audio stream bps not 0, we think have video or audio;
+    bool has_video = statistics.video_bps_ > 0;
+    bool has_audio = statistics.audio_bps_ > 0;
+    
+    if(has_audio && DiiUnixTimestampMs() - last_play_audio_frame_ts_ > 10*1000) {
+       last_play_audio_frame_ts_ = DiiUnixTimestampMs();
+       DII_LOG(LS_ERROR, stream_id_, 2002015) << "no audio packet played for more than 10 seconds.";
+    }
+       
+    if(has_video && DiiUnixTimestampMs() - last_render_video_frame_ts_  > 10*1000) {
+       last_render_video_frame_ts_ = DiiUnixTimestampMs();
+       DII_LOG(LS_ERROR, stream_id_, 2002016) << "no video frame render for more than 10 seconds.";
     }
 }
 
@@ -384,6 +503,11 @@ void DiiMediaCore::OnStreamSyncTime(uint64_t ts) {
         callback_.sync_ts_callback(ts);
 }
 
+void DiiMediaCore::OnAudioVisualization(int mode, const float* data, int size) {
+    if(callback_.visualization_callback)
+        callback_.visualization_callback((DiiVisualizationMode)mode, data, size, callback_.custom_data);
+}
+
 int32_t DiiMediaCore::ClearDisplayWithColor(int32_t width, int32_t height, uint8_t r, uint8_t g, uint8_t b) {
     if(!started_) {
         return DII_ERROR;
@@ -427,6 +551,77 @@ int32_t DiiMediaCore::ClearDisplayWithColor(int32_t width, int32_t height, uint8
 void DiiMediaCore::OnVideoFrame(dii_media_kit::VideoFrame& frame) {
     is_video_frame_coming_ = true;
     last_render_video_frame_ts_ = DiiUnixTimestampMs();
+
+    {
+        // decoder only queues the frame, oldest one is dropped if app is behind.
+        std::unique_lock<std::mutex> lck(delivery_mtx_);
+        if (delivery_queue_size_ > 0) {
+            while ((int32_t)delivery_queue_.size() >= delivery_queue_size_) {
+                delivery_queue_.pop_front();
+                delivery_dropped_frames_++;
+            }
+            DeliveryItem item;
+            item.frame = frame;
+            item.queue_time = dii_rtc::TimeMillis();
+            delivery_queue_.push_back(item);
+            delivery_cond_.notify_one();
+            return;
+        }
+    }
+    this->RenderVideoFrame(frame);
+}
+
+int32_t DiiMediaCore::SetAsyncVideoDelivery(int32_t queue_size) {
+    if (queue_size < 0 || queue_size > DII_DELIVERY_QUEUE_MAX) {
+        return DII_PARAMETER_ERROR;
+    }
+    // held across join, next enable can't start a thread before old one exits.
+    std::unique_lock<std::mutex> ctl_lck(delivery_ctl_mtx_);
+    std::thread* thread = nullptr;
+    {
+        std::unique_lock<std::mutex> lck(delivery_mtx_);
+        delivery_queue_size_ = queue_size;
+        if (queue_size > 0 && !delivery_thread_) {
+            delivery_running_ = true;
+            delivery_thread_ = new std::thread(&DiiMediaCore::DeliveryLoop, this);
+        } else if (queue_size == 0 && delivery_thread_) {
+            delivery_running_ = false;
+            delivery_cond_.notify_all();
+            thread = delivery_thread_;
+            delivery_thread_ = nullptr;
+        }
+    }
+    if (thread) {
+        if (thread->joinable()) {
+            thread->join();
+        }
+        delete thread;
+    }
+    return DII_DONE;
+}
+
+// app callbacks, conversion and renderer, out of decoder thread.
+void DiiMediaCore::DeliveryLoop() {
+    for (;;) {
+        DeliveryItem item;
+        {
+            std::unique_lock<std::mutex> lck(delivery_mtx_);
+            delivery_cond_.wait(lck, [this] { return !delivery_running_ || !delivery_queue_.empty(); });
+            if (!delivery_running_) {
+                delivery_queue_.clear();
+                return;
+            }
+            item = delivery_queue_.front();
+            delivery_queue_.pop_front();
+            if (dii_rtc::TimeMillis() - item.queue_time > DII_DELIVERY_LATE_MS) {
+                delivery_late_frames_++;
+            }
+        }
+        this->RenderVideoFrame(item.frame);
+    }
+}
+
+void DiiMediaCore::RenderVideoFrame(dii_media_kit::VideoFrame& frame) {
 	if (render_time_flg_) {
 		end_time_ = DiiUnixTimestampMs();
 		render_time_flg_ = false;
@@ -462,40 +657,7 @@ void DiiMediaCore::OnVideoFrame(dii_media_kit::VideoFrame& frame) {
     }
     
     if (callback_.video_frame_callback) {
-        std::unique_lock<std::mutex> lck(set_video_size_mtx_);
-        if(scale_width_ == 0 || scale_height_ == 0) {
-            scale_width_ = frame.width();
-            scale_height_ = frame.height();
-        }
-        
-		if (src_rgba_frame_buf_.size() < frame.width()*frame.height()*4) {
-            src_rgba_frame_buf_.resize(frame.width()*frame.height()*4);
-        }
-        
-        if (dst_rgba_frame_buf_.size() < scale_width_ * scale_height_ * 4) {
-            dst_rgba_frame_buf_.resize(scale_width_ * scale_height_ * 4);
-        }
-        
-           
-        //convert
-        dii_media_kit::ConvertFromI420(frame, dii_media_kit::kABGR, 0, src_rgba_frame_buf_.data());
-
-        //回调
-        dii_media_kit::DiiVideoFrame dst;
-        dst.type = dii_media_kit::DiiVideoFrameType::TYPE_RGBA32;
-        dst.render_time_ms = frame.render_time_ms();
-        dst.rotation = frame.rotation();
-        dst.rgba_buffer = dst_rgba_frame_buf_.data();
-        //FIXME: need mutex， if sacla_width or heigth change, up level may crash
-        dst.rgba_buffer_len = scale_width_ * scale_height_ * 4;
-        dst.width = scale_width_;
-        dst.height = scale_height_;
-        
-        DII_LOG(LS_VERBOSE, stream_id_, 0) << "origin width:" <<  frame.width() << ", height:" << frame.height() << ", dst width:" << dst.width << ",dst height:" <<  dst.height << "buffer:" << dst.rgba_buffer;
-        callback_.video_frame_callback(dst, callback_.custom_data);
-
-        orig_width_ = frame.width();
-        orig_height_ = frame.height();
+        this->DeliverVideoFrame(frame);
     }
     
     // Do render video frame
@@ -505,6 +667,172 @@ void DiiMediaCore::OnVideoFrame(dii_media_kit::VideoFrame& frame) {
     }
 }
 
+// large frames run in bands on worker pool, small ones are not worth the hand-off.
+static int ConvertBands(int pixels, int rows) {
+    if (pixels < DII_PARALLEL_CONVERT_PIXELS) {
+        return 1;
+    }
+    int bands = DiiWorkerPool::GetInstance()->Concurrency();
+    return std::max(1, std::min(bands, rows / DII_CONVERT_BAND_MIN_ROWS));
+}
+
+// even row boundaries, chroma rows of 420 are not split.
+static void BandRows(int height, int bands, int index, int* y0, int* y1) {
+    *y0 = (int)((int64_t)height * index / bands) & ~1;
+    *y1 = index == bands - 1 ? height : (int)((int64_t)height * (index + 1) / bands) & ~1;
+}
+
+// scale in I420 first, then convert the smaller picture to what app wants.
+void DiiMediaCore::DeliverVideoFrame(dii_media_kit::VideoFrame& frame) {
+    std::unique_lock<std::mutex> lck(set_video_size_mtx_);
+    dii_rtc::scoped_refptr<VideoFrameBuffer> src = frame.video_frame_buffer();
+    if (!src) {
+        return;
+    }
+    if (src->native_handle()) {
+        src = src->NativeToI420Buffer();
+    }
+
+    int width = scale_width_;
+    int height = scale_height_;
+    if (width <= 0 && height <= 0) {
+        width = src->width();
+        height = src->height();
+    } else if (width <= 0) {
+        width = (int)((int64_t)src->width() * height / src->height()) & ~1;
+    } else if (height <= 0) {
+        height = (int)((int64_t)src->height() * width / src->width()) & ~1;
+    }
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    int64_t convert_start = dii_rtc::TimeMicros();
+    if (width != src->width() || height != src->height()) {
+        dii_rtc::scoped_refptr<I420Buffer> scaled = scale_buffer_pool_.CreateBuffer(width, height);
+        if (!scaled) {
+            return;
+        }
+        // band by output rows, each band scales the source rows mapped onto it
+        int src_height = src->height();
+        int bands = ConvertBands(std::max(src->width() * src_height, width * height), std::min(height, src_height));
+        DiiWorkerPool::GetInstance()->ParallelFor(bands, [&](int32_t i) {
+            int y0, y1;
+            BandRows(height, bands, i, &y0, &y1);
+            int sy0 = i == 0 ? 0 : (int)((int64_t)y0 * src_height / height) & ~1;
+            int sy1 = i == bands - 1 ? src_height : (int)((int64_t)y1 * src_height / height) & ~1;
+            dii_libyuv::I420Scale(src->DataY() + sy0 * src->StrideY(), src->StrideY(),
+                                  src->DataU() + sy0 / 2 * src->StrideU(), src->StrideU(),
+                                  src->DataV() + sy0 / 2 * src->StrideV(), src->StrideV(),
+                                  src->width(), sy1 - sy0,
+                                  scaled->MutableDataY() + y0 * scaled->StrideY(), scaled->StrideY(),
+                                  scaled->MutableDataU() + y0 / 2 * scaled->StrideU(), scaled->StrideU(),
+                                  scaled->MutableDataV() + y0 / 2 * scaled->StrideV(), scaled->StrideV(),
+                                  width, y1 - y0, dii_libyuv::kFilterBox);
+        });
+        src = scaled;
+    }
+
+    dii_media_kit::DiiVideoFrame dst;
+    memset(&dst, 0, sizeof(dst));
+    dst.type = output_format_;
+    dst.width = width;
+    dst.height = height;
+    dst.render_time_ms = frame.render_time_ms();
+    dst.sync_ts = frame.ntp_time_ms() > 0 ? frame.ntp_time_ms() : 0;
+    dst.rotation = frame.rotation();
+
+    int chroma_width = (width + 1) / 2;
+    int chroma_height = (height + 1) / 2;
+    int bands = ConvertBands(width * height, height);
+    const uint8_t* src_y = src->DataY();
+    const uint8_t* src_u = src->DataU();
+    const uint8_t* src_v = src->DataV();
+    int stride_y = src->StrideY();
+    int stride_u = src->StrideU();
+    int stride_v = src->StrideV();
+    switch (output_format_) {
+        case TYPE_YUV420:
+            // decoded (or scaled) buffer itself, app may retain it by frame_handle
+            dst.frame_handle = src.get();
+            dst.y_buffer = (void*)src_y;
+            dst.u_buffer = (void*)src_u;
+            dst.v_buffer = (void*)src_v;
+            dst.y_stride = stride_y;
+            dst.u_stride = stride_u;
+            dst.v_stride = stride_v;
+            break;
+        case TYPE_NV12: {
+            dst_rgba_frame_buf_.resize(width * height + chroma_width * 2 * chroma_height);
+            uint8_t* dst_y = dst_rgba_frame_buf_.data();
+            uint8_t* dst_uv = dst_y + width * height;
+            int stride_uv = chroma_width * 2;
+            dst.y_buffer = dst_y;
+            dst.y_stride = width;
+            dst.u_buffer = dst_uv;
+            dst.u_stride = stride_uv;
+            DiiWorkerPool::GetInstance()->ParallelFor(bands, [&](int32_t i) {
+                int y0, y1;
+                BandRows(height, bands, i, &y0, &y1);
+                dii_libyuv::I420ToNV12(src_y + y0 * stride_y, stride_y,
+                                       src_u + y0 / 2 * stride_u, stride_u,
+                                       src_v + y0 / 2 * stride_v, stride_v,
+                                       dst_y + y0 * width, width,
+                                       dst_uv + y0 / 2 * stride_uv, stride_uv,
+                                       width, y1 - y0);
+            });
+            break;
+        }
+        case TYPE_BGRA32:
+        case TYPE_RGBA32: {
+            dst_rgba_frame_buf_.resize(width * height * 4);
+            uint8_t* dst_rgba = dst_rgba_frame_buf_.data();
+            bool bgra = output_format_ == TYPE_BGRA32;
+            dst.rgba_buffer = dst_rgba;
+            dst.rgba_buffer_len = width * height * 4;
+            DiiWorkerPool::GetInstance()->ParallelFor(bands, [&](int32_t i) {
+                int y0, y1;
+                BandRows(height, bands, i, &y0, &y1);
+                // libyuv names by word order, ARGB is B G R A in memory, ABGR is R G B A
+                if (bgra) {
+                    dii_libyuv::I420ToARGB(src_y + y0 * stride_y, stride_y,
+                                           src_u + y0 / 2 * stride_u, stride_u,
+                                           src_v + y0 / 2 * stride_v, stride_v,
+                                           dst_rgba + y0 * width * 4, width * 4,
+                                           width, y1 - y0);
+                } else {
+                    dii_libyuv::I420ToABGR(src_y + y0 * stride_y, stride_y,
+                                           src_u + y0 / 2 * stride_u, stride_u,
+                                           src_v + y0 / 2 * stride_v, stride_v,
+                                           dst_rgba + y0 * width * 4, width * 4,
+                                           width, y1 - y0);
+                }
+            });
+            break;
+        }
+    }
+    convert_time_us_ += dii_rtc::TimeMicros() - convert_start;
+    convert_frames_++;
+
+    DII_LOG(LS_VERBOSE, stream_id_, 0) << "origin width:" <<  frame.width() << ", height:" << frame.height() << ", dst width:" << dst.width << ",dst height:" <<  dst.height << ", format:" << dst.type;
+    callback_.video_frame_callback(dst, callback_.custom_data);
+
+    orig_width_ = frame.width();
+    orig_height_ = frame.height();
+}
+
+int32_t DiiMediaCore::SetVideoOutputFormat(int32_t width, int32_t height, DiiVideoFrameType format) {
+    if (format < TYPE_YUV420 || format > TYPE_BGRA32) {
+        return DII_PARAMETER_ERROR;
+    }
+    std::unique_lock<std::mutex> lck(set_video_size_mtx_);
+    // even size, chroma planes of 420 are half
+    scale_width_ = width > 0 ? (width + 1) & ~1 : 0;
+    scale_height_ = height > 0 ? (height + 1) & ~1 : 0;
+    output_format_ = format;
+    return DII_DONE;
+}
+
 int32_t DiiMediaCore::SetPlayerCallback(DiiPlayerCallback* callback) {
     if(!callback) {
         return -1;
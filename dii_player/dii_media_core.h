@@ -14,6 +14,13 @@
 #include "video_renderer.h"
 #include "dii_audio_manager.h"
 #include "dii_media_utils.h"
+#include "dii_timer_wheel.h"
+#include "webrtc/common_video/include/i420_buffer_pool.h"
+
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <condition_variable>
 
 namespace dii_media_kit  {
     class DiiMediaCore : public dii_media_kit::DiiAudioTracker,
@@ -27,6 +34,9 @@ namespace dii_media_kit  {
         int32_t Pause();
         int32_t Resume();
         int32_t SetLoop(bool loop);
+        int32_t SetPlaybackRate(float rate);
+        int32_t SelectAudioTrack(int32_t index);
+        int32_t SetFFPlayOptions(const DiiFFPlayOptions& options);
         int32_t StopPlay();
         int32_t Seek(int64_t pos);
         void SetMute(const bool mute);
@@ -34,6 +44,8 @@ namespace dii_media_kit  {
         int64_t Duration();
 
         int32_t SetPlayerCallback(DiiPlayerCallback* callback);
+        int32_t SetVideoOutputFormat(int32_t width, int32_t height, DiiVideoFrameType format);
+        int32_t SetAsyncVideoDelivery(int32_t queue_size);
         int32_t ClearDisplayWithColor(int32_t width, int32_t height, uint8_t r = 0, uint8_t g = 0, uint8_t b = 0);
         
         int32_t OnNeedPlayAudio(void* audioSamples, size_t samplesPerSec, size_t nChannels) override;
@@ -46,9 +58,14 @@ namespace dii_media_kit  {
 
     private:
         void OnVideoFrame(dii_media_kit::VideoFrame& frame);
+        void RenderVideoFrame(dii_media_kit::VideoFrame& frame);
+        void DeliveryLoop();
+        void DeliverVideoFrame(dii_media_kit::VideoFrame& frame);
 		void OnPlayerState(int state, int code, const char* msg);
         void DoStatistics();
+        void ReportStatistics(DiiPlayerStatistics& statistics);
         void OnStreamSyncTime(uint64_t ts);
+        void OnAudioVisualization(int mode, const float* data, int size);
   
         void StartAudioPlayout();
         void StopAudioPlayout();
@@ -63,34 +80,54 @@ namespace dii_media_kit  {
         
         std::mutex set_video_size_mtx_;
         std::shared_ptr<DiiAudioManager> audio_manager_;
+        std::shared_ptr<DiiTimerWheel> timer_wheel_;
         std::string play_uri_ = "";
         int64_t play_pos_ = 0;
         
         bool started_ = false;
         bool paused_  = false;
         bool loop_    = false;
+        float playback_rate_ = 1.0f;
         bool mute_    = false;
 		bool render_time_flg_ = false;
         
         DiiPlayBase* player_ = nullptr;
         dii_rtc::VideoSinkInterface<cricket::VideoFrame>*  video_render_ = nullptr;
 
-		int scale_width_    = 0;
+		int scale_width_    = 0;    // output size set by app, 0: source size
 		int scale_height_   = 0;
+        DiiVideoFrameType output_format_ = TYPE_RGBA32;
+        I420BufferPool scale_buffer_pool_;     // scaled frames may be retained by app
+        std::atomic<int64_t> convert_time_us_{0};   // scale + convert cost since last statistics
+        std::atomic<int32_t> convert_frames_{0};
+
+        // async video delivery, queue_size 0: callbacks run on decoder thread
+        struct DeliveryItem {
+            dii_media_kit::VideoFrame frame;
+            int64_t queue_time;
+        };
+        std::mutex delivery_ctl_mtx_;          // serializes enable / disable
+        std::mutex delivery_mtx_;
+        std::condition_variable delivery_cond_;
+        std::deque<DeliveryItem> delivery_queue_;
+        std::thread* delivery_thread_ = nullptr;
+        bool delivery_running_ = false;
+        int32_t delivery_queue_size_ = 0;
+        int32_t delivery_dropped_frames_ = 0;
+        int32_t delivery_late_frames_ = 0;
 		int orig_width_     = 0;
 		int orig_height_    = 0;
         
 		int64_t start_time_ = 0;
 		int64_t end_time_ = 0;
-        std::vector<uint8_t> src_rgba_frame_buf_;
-        std::vector<uint8_t> dst_rgba_frame_buf_;
-        std::vector<uint8_t> scale_rgba_frame_buf_;
+        std::vector<uint8_t> dst_rgba_frame_buf_;   // rgba / bgra / nv12 output
         int32_t frame_width_     = 0;
         int32_t frame_height_    = 0;
 		int64_t start_to_render_time_ = 0;
 
         DiiPlayerCallback callback_;
-        DiiPlayerStatistics statistics_;
+        DiiPlayerStatistics statistics_;    // collected on timer wheel thread
+        DiiFFPlayOptions ffplay_options_;
 		DiiPlayerState player_cur_stat_ = DII_STATE_STOPPED;
         
 		static uint32_t dev_volume_;
@@ -7,6 +7,8 @@
 //
 
 #include "dii_media_utils.h"
+#include "dii_memory_budget.h"
+#include "dii_http_cache.h"
 
 #include <ctime>
 #include <time.h>
@@ -26,6 +28,18 @@ void DiiMediaKit::SetEventTrackinglCallback(DiiEventTrackingCallback callback) {
     DiiUtil::Instance()->SetEventTrackinglCallback(callback);
 }
 
+void DiiMediaKit::SetMemoryBudget(int64_t bytes) {
+    DiiMemoryBudget::Instance()->SetBudget(bytes);
+}
+
+void DiiMediaKit::SetCacheDir(const char* path) {
+    DiiUtil::Instance()->SetCacheDir(path);
+}
+
+void DiiMediaKit::SetHttpCacheSize(int64_t bytes) {
+    DiiHttpCacheStore::Instance()->SetCapacity(bytes);
+}
+
 int DiiMediaKit::SetRadarCallback(dii_radar::DiiRadarCallback callback) {
     return DiiUtil::Instance()->SetRadarCallback(callback);
 }
@@ -34,6 +48,7 @@ int DiiMediaKit::SetRadarCallback(dii_radar::DiiRadarCallback callback) {
 DiiPlayerStatisticsCallback DiiUtil::external_statistics_callback_   = nullptr;
 DiiEventTrackingCallback DiiUtil::event_tracking_callback_           = nullptr;
 dii_radar::DiiRadarCallback DiiUtil::radar_callback_;
+std::string DiiUtil::cache_dir_;
 
 int32_t DiiUtil::stream_id_ = 1000;
 std::mutex DiiUtil::mtx_;
@@ -77,6 +92,16 @@ dii_radar::DiiRadarCallback DiiUtil::GetRadarCallback() {
     return radar_callback_;
 }
 
+void DiiUtil::SetCacheDir(const char* path) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    cache_dir_ = path ? path : "";
+}
+
+std::string DiiUtil::GetCacheDir() {
+    std::unique_lock<std::mutex> lck(mtx_);
+    return cache_dir_;
+}
+
 void DiiUtil::TraceEvent(int32_t code, std::string msg, std::string func, int32_t line) {
     DiiTrackEvent event;
     event.line = line;
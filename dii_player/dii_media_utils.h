@@ -14,6 +14,7 @@
 #include "webrtc/base/logging.h"
 
 #include <list>
+#include <string>
 #include <functional>
 #include <thread>
 #include <mutex>
@@ -30,6 +31,8 @@ public:
     void ExternalStatisticsCallback(DiiPlayerStatistics st);
     int SetRadarCallback(dii_radar::DiiRadarCallback callback);
     dii_radar::DiiRadarCallback GetRadarCallback();
+    void SetCacheDir(const char* path);
+    std::string GetCacheDir();
     
     int32_t CreateStreamId();
 
@@ -42,6 +45,7 @@ private:
     static DiiPlayerStatisticsCallback external_statistics_callback_;
     static DiiEventTrackingCallback event_tracking_callback_;
     static dii_radar::DiiRadarCallback radar_callback_;
+    static std::string cache_dir_;
 
     static std::mutex mtx_;
     static int32_t stream_id_;
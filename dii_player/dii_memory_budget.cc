@@ -0,0 +1,141 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_memory_budget.h"
+#include "webrtc/base/logging.h"
+
+#define DII_MEM_DEFAULT_BUDGET         (512 * 1024 * 1024LL)
+
+// percent of budget
+#define DII_MEM_DROP_NONREF_PERCENT    60
+#define DII_MEM_SHRINK_CACHE_PERCENT   80
+#define DII_MEM_PAUSE_READ_PERCENT     95
+// leave a level only this far below its entry, no flapping around a threshold
+#define DII_MEM_HYSTERESIS_PERCENT     5
+
+namespace dii_media_kit {
+DiiMemoryAccount::DiiMemoryAccount(int32_t stream_id)
+    : stream_id_(stream_id)
+    , compressed_bytes_(0)
+    , decoded_bytes_(0) {
+}
+
+DiiMemoryAccount::~DiiMemoryAccount() {
+    // give back what not released by owner.
+    DiiMemoryBudget::Instance()->Update(-(compressed_bytes_ + decoded_bytes_));
+}
+
+void DiiMemoryAccount::AddCompressed(int64_t bytes) {
+    compressed_bytes_ += bytes;
+    DiiMemoryBudget::Instance()->Update(bytes);
+}
+
+void DiiMemoryAccount::AddDecoded(int64_t bytes) {
+    decoded_bytes_ += bytes;
+    DiiMemoryBudget::Instance()->Update(bytes);
+}
+
+DiiMemoryBudget* DiiMemoryBudget::mem_budget_ins_ = nullptr;
+std::mutex* DiiMemoryBudget::ins_mtx_ = new std::mutex();
+DiiMemoryBudget* DiiMemoryBudget::Instance() {
+    if (mem_budget_ins_ == nullptr) {
+        ins_mtx_->lock();
+        if (mem_budget_ins_ == nullptr) {
+            mem_budget_ins_ = new DiiMemoryBudget();
+        }
+        ins_mtx_->unlock();
+    }
+    return mem_budget_ins_;
+}
+
+DiiMemoryBudget::DiiMemoryBudget()
+    : budget_(DII_MEM_DEFAULT_BUDGET)
+    , total_bytes_(0)
+    , pressure_(DII_MEM_PRESSURE_NONE) {
+}
+
+void DiiMemoryBudget::SetBudget(int64_t bytes) {
+    LOG(LS_INFO) << "set memory budget: " << bytes << " bytes.";
+    budget_ = bytes;
+    this->Update(0);
+}
+
+DiiMemoryAccount* DiiMemoryBudget::CreateAccount(int32_t stream_id) {
+    DiiMemoryAccount* account = new DiiMemoryAccount(stream_id);
+    std::unique_lock<std::mutex> lck(mtx_);
+    accounts_.push_back(account);
+    return account;
+}
+
+void DiiMemoryBudget::ReleaseAccount(DiiMemoryAccount* account) {
+    if (!account) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        accounts_.remove(account);
+    }
+    delete account;
+}
+
+int64_t DiiMemoryBudget::StreamUsage(int32_t stream_id) {
+    int64_t bytes = 0;
+    std::unique_lock<std::mutex> lck(mtx_);
+    for (auto it : accounts_) {
+        if (it->StreamId() == stream_id) {
+            bytes += it->CompressedBytes() + it->DecodedBytes();
+        }
+    }
+    return bytes;
+}
+
+void DiiMemoryBudget::Update(int64_t delta) {
+    static const int64_t kEntryPercent[] = {0, DII_MEM_DROP_NONREF_PERCENT,
+        DII_MEM_SHRINK_CACHE_PERCENT, DII_MEM_PAUSE_READ_PERCENT};
+
+    total_bytes_ += delta;
+
+    // level from the latest total under lock, a late updater never leaves a stale level.
+    std::unique_lock<std::mutex> lck(level_mtx_);
+    int64_t total = total_bytes_;
+    int64_t budget = budget_;
+    int32_t pre = pressure_;
+    int32_t pressure = DII_MEM_PRESSURE_NONE;
+    if (budget > 0) {
+        int64_t percent = total * 100 / budget;
+        pressure = DII_MEM_PRESSURE_PAUSE_READ;
+        while (pressure > DII_MEM_PRESSURE_NONE && percent < kEntryPercent[pressure]) {
+            pressure--;
+        }
+        if (pre > pressure) {
+            int32_t keep = pre;
+            while (keep > pressure && percent < kEntryPercent[keep] - DII_MEM_HYSTERESIS_PERCENT) {
+                keep--;
+            }
+            pressure = keep;
+        }
+    }
+
+    if (pre != pressure) {
+        pressure_ = pressure;
+        LOG(LS_WARNING) << "memory pressure level changed: " << pre << " -> " << pressure
+                        << ", usage: " << total << ", budget: " << budget;
+    }
+}
+
+}	// namespace dii_media_kit
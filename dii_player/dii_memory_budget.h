@@ -0,0 +1,91 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_MEMORY_BUDGET_H__
+#define __DII_MEMORY_BUDGET_H__
+
+#include <stdint.h>
+#include <list>
+#include <mutex>
+#include <atomic>
+
+namespace dii_media_kit {
+
+// step by step, every level include the lower level actions.
+typedef enum {
+    DII_MEM_PRESSURE_NONE = 0,
+    DII_MEM_PRESSURE_DROP_NONREF,     // drop non-reference video frame
+    DII_MEM_PRESSURE_SHRINK_CACHE,    // shrink jitter buffer / queue target
+    DII_MEM_PRESSURE_PAUSE_READ,      // stop reading from network/file
+} DiiMemoryPressure;
+
+/* Bytes cached by one player, compressed (packets) and decoded (pcm / frames).
+ * Created by DiiMemoryBudget, update is lock free.
+ */
+class DiiMemoryAccount {
+public:
+    explicit DiiMemoryAccount(int32_t stream_id);
+    ~DiiMemoryAccount();
+
+    void AddCompressed(int64_t bytes);
+    void AddDecoded(int64_t bytes);
+    int64_t CompressedBytes() const { return compressed_bytes_; };
+    int64_t DecodedBytes() const { return decoded_bytes_; };
+    int32_t StreamId() const { return stream_id_; };
+
+private:
+    int32_t stream_id_;
+    std::atomic<int64_t> compressed_bytes_;
+    std::atomic<int64_t> decoded_bytes_;
+};
+
+class DiiMemoryBudget {
+public:
+    static DiiMemoryBudget* Instance();
+
+    // bytes <= 0 means unlimited.
+    void SetBudget(int64_t bytes);
+    int64_t Budget() const { return budget_; };
+
+    DiiMemoryAccount* CreateAccount(int32_t stream_id);
+    void ReleaseAccount(DiiMemoryAccount* account);
+
+    int64_t TotalUsage() const { return total_bytes_; };
+    int64_t StreamUsage(int32_t stream_id);
+    DiiMemoryPressure Pressure() const { return (DiiMemoryPressure)pressure_.load(); };
+
+private:
+    friend class DiiMemoryAccount;
+    DiiMemoryBudget();
+    void Update(int64_t delta);
+
+private:
+    static std::mutex *ins_mtx_;
+    static DiiMemoryBudget* mem_budget_ins_;
+
+    std::mutex                      mtx_;
+    std::mutex                      level_mtx_;
+    std::list<DiiMemoryAccount*>    accounts_;
+    std::atomic<int64_t>            budget_;
+    std::atomic<int64_t>            total_bytes_;
+    std::atomic<int32_t>            pressure_;
+};
+
+}	// namespace dii_media_kit
+
+#endif	// __DII_MEMORY_BUDGET_H__
@@ -26,11 +26,13 @@ namespace dii_media_kit  {
     typedef std::function<void (int state, int code, const char* msg)> StateCallback;
     typedef std::function<void (int buffer_len, int net_speed)> NetworkStatisticsCallback;
     typedef std::function<void (uint64_t ts)> RtmpSyncTimeCallback;
+    typedef std::function<void (int mode, const float* data, int size)> AudioVisualizationCallback;
 
     typedef struct {
         VideoFrameCallback video_frame_callback_                = nullptr;
         StateCallback state_callback_                           = nullptr;
         RtmpSyncTimeCallback rtmp_sync_time_callback_           = nullptr;
+        AudioVisualizationCallback audio_visualization_callback_ = nullptr;
     } DiiMediaBaseCallback;
 
     class DiiPlayBase {
@@ -41,6 +43,8 @@ namespace dii_media_kit  {
         virtual int32_t Resume() = 0;
         virtual int32_t StopPlay() = 0;
         virtual int32_t SetLoop(bool loop) = 0;
+        virtual int32_t SetPlaybackRate(float rate) = 0;
+        virtual int32_t SelectAudioTrack(int32_t index) = 0;
         virtual int32_t Seek(int64_t pos) = 0;
 
         virtual int64_t Position() = 0;
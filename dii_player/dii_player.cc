@@ -8,6 +8,7 @@
 
 #include "dii_player.h"
 #include "dii_media_core.h"
+#include "dii_thumbnail.h"
 #include <list>
 
 namespace dii_media_kit {
@@ -75,6 +76,53 @@ namespace dii_media_kit {
         return ret;
     }
 
+    int32_t DiiPlayer::SetPlaybackRate(float rate) {
+        DII_LOG(LS_INFO, this->stream_id_, 0) << "SetPlaybackRate, rate:" << rate;
+        int32_t ret = dii_player_->SetPlaybackRate(rate);
+        if(ret < 0) {
+            DII_LOG(LS_ERROR, this->stream_id_, 0) << "SetPlaybackRate faild, ret:" << ret;
+        }
+        return ret;
+    }
+
+    int32_t DiiPlayer::SelectAudioTrack(int32_t index) {
+        DII_LOG(LS_INFO, this->stream_id_, 0) << "SelectAudioTrack, index:" << index;
+        int32_t ret = dii_player_->SelectAudioTrack(index);
+        if(ret < 0) {
+            DII_LOG(LS_ERROR, this->stream_id_, 0) << "SelectAudioTrack faild, ret:" << ret;
+        }
+        return ret;
+    }
+
+    int32_t DiiPlayer::SetVideoOutputFormat(int32_t width, int32_t height, DiiVideoFrameType format) {
+        DII_LOG(LS_INFO, this->stream_id_, 0) << "SetVideoOutputFormat, width:" << width << ", height:" << height << ", format:" << format;
+        int32_t ret = dii_player_->SetVideoOutputFormat(width, height, format);
+        if(ret < 0) {
+            DII_LOG(LS_ERROR, this->stream_id_, 0) << "SetVideoOutputFormat faild, ret:" << ret;
+        }
+        return ret;
+    }
+
+    int32_t DiiPlayer::SetAsyncVideoDelivery(int32_t queue_size) {
+        DII_LOG(LS_INFO, this->stream_id_, 0) << "SetAsyncVideoDelivery, queue size:" << queue_size;
+        int32_t ret = dii_player_->SetAsyncVideoDelivery(queue_size);
+        if(ret < 0) {
+            DII_LOG(LS_ERROR, this->stream_id_, 0) << "SetAsyncVideoDelivery faild, ret:" << ret;
+        }
+        return ret;
+    }
+
+    int32_t DiiPlayer::SetFFPlayOptions(const DiiFFPlayOptions& options) {
+        DII_LOG(LS_INFO, this->stream_id_, 0) << "SetFFPlayOptions"
+                                                << ", decoder threads=" << options.decoder_threads
+                                                << ", lowres="          << options.lowres
+                                                << ", framedrop="       << options.framedrop
+                                                << ", infinite buffer=" << options.infinite_buffer
+                                                << ", probesize="       << options.probesize
+                                                << ", sync master="     << options.sync_master;
+        return dii_player_->SetFFPlayOptions(options);
+    }
+
 	int32_t DiiPlayer::Stop() {
 		DII_LOG(LS_INFO, this->stream_id_, 0) << "stop.";
 		int32_t ret = dii_player_->StopPlay();
@@ -127,6 +175,37 @@ namespace dii_media_kit {
         return 0;
 	}
 
+    int32_t DiiPlayer::GetThumbnails(const char* url, const int64_t* timestamps, int32_t count,
+                                     int32_t width, int32_t height, DiiThumbnailCallback callback) {
+        if (!url) {
+            LOG(LS_ERROR) << "GetThumbnails url is null.";
+            return DII_PARAMETER_ERROR;
+        }
+        LOG(LS_INFO) << "GetThumbnails, url=" << url << ", count=" << count
+                     << ", size=" << width << "x" << height;
+        int32_t ret = DiiThumbnailExtractor::GetInstance()->GetThumbnails(url, timestamps, count, width, height, callback);
+        if(ret < 0) {
+            LOG(LS_ERROR) << "GetThumbnails failed ret=" << ret;
+        }
+        return ret;
+    }
+
+    int32_t DiiPlayer::RetainVideoFrame(const DiiVideoFrame& frame) {
+        if (frame.type != TYPE_YUV420 || !frame.frame_handle) {
+            return DII_PARAMETER_ERROR;
+        }
+        static_cast<VideoFrameBuffer*>(frame.frame_handle)->AddRef();
+        return DII_DONE;
+    }
+
+    int32_t DiiPlayer::ReleaseVideoFrame(const DiiVideoFrame& frame) {
+        if (frame.type != TYPE_YUV420 || !frame.frame_handle) {
+            return DII_PARAMETER_ERROR;
+        }
+        static_cast<VideoFrameBuffer*>(frame.frame_handle)->Release();
+        return DII_DONE;
+    }
+
     int32_t DiiPlayer::SetPlayoutVolume(uint32_t vol) {
 		LOG(LS_INFO) << "Set playout volume volume=" << vol;
         int ret = DiiMediaCore::SetPlayoutVolume(vol);
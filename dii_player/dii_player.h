@@ -42,6 +42,34 @@ namespace dii_media_kit  {
         int32_t SetLoop(bool loop);
 		int32_t Stop();
 
+		/**
+		* Playback speed of file / vod stream, pitch is kept.
+		*
+		* @param rate 0.5 ~ 3.0, 1.0 is normal speed, kept for next Start.
+		*
+		* @return 0 on success < 0 on failure.
+		*
+		*/
+		int32_t SetPlaybackRate(float rate);
+
+		/**
+		* Switch audio track of file / vod stream, instant with DiiFFPlayOptions::audio_track_cache.
+		*
+		* @param index audio track in file order, 0 based.
+		*
+		* @return 0 on success < 0 on failure.
+		*
+		*/
+		int32_t SelectAudioTrack(int32_t index);
+
+		/**
+		* Options for file / vod stream, take effect at next Start.
+		*
+		* @return 0 on success < 0 on failure.
+		*
+		*/
+		int32_t SetFFPlayOptions(const DiiFFPlayOptions& options);
+
 		/**
 		* Forward or back the current stream
 		*
@@ -58,8 +86,53 @@ namespace dii_media_kit  {
 
         int32_t Get10msAudioData(uint8_t* buffer, int32_t sample_rate, int32_t channel_nb);
         int32_t SetPlayerCallback(DiiPlayerCallback* callback);
+
+        /**
+        * Size and pixel format of frames given to video_frame_callback, scaled in YUV before conversion.
+        *
+        * @param width, height output size, <= 0 keep aspect ratio by the other one, both <= 0 keep source size.
+        * @param format TYPE_YUV420 is given without any conversion, default TYPE_RGBA32.
+        *
+        * @return 0 on success < 0 on failure.
+        *
+        */
+        int32_t SetVideoOutputFormat(int32_t width, int32_t height, DiiVideoFrameType format);
+
+        /**
+        * Run video callbacks and render on a delivery thread, decoder never waits for app.
+        * Frames are queued, oldest one is dropped when queue is full.
+        *
+        * @param queue_size 1 ~ 16 frames, 0 callbacks run on decoder thread (default).
+        *
+        * @return 0 on success < 0 on failure.
+        *
+        */
+        int32_t SetAsyncVideoDelivery(int32_t queue_size);
         int32_t ClearDisplayView(int32_t width = 640, int32_t height = 480, uint8_t r = 0, uint8_t g = 0, uint8_t b = 0);
     
+        /**
+        * Extract timeline preview thumbnails (keyframe nearest before each timestamp),
+        * independent of playing stream, cached thumbnails are called back before return.
+        *
+        * @param timestamps time positions(ms).
+        * @param width, height thumbnail size, <= 0 keep aspect ratio by the other one.
+        *
+        * @return 0 on success < 0 on failure.
+        *
+        */
+        static int32_t GetThumbnails(const char* url, const int64_t* timestamps, int32_t count,
+                                     int32_t width, int32_t height, DiiThumbnailCallback callback);
+
+        /**
+        * Keep y/u/v planes of a TYPE_YUV420 frame valid after callback returned, no copy.
+        * Decoder allocates other buffers meanwhile, every retain must be released.
+        *
+        * @return 0 on success < 0 on failure.
+        *
+        */
+        static int32_t RetainVideoFrame(const DiiVideoFrame& frame);
+        static int32_t ReleaseVideoFrame(const DiiVideoFrame& frame);
+
         // support for windows & mac
         static int32_t SetPlayoutVolume(uint32_t vol);
 		static int32_t SetPlayoutDevice(const char* deviceId);
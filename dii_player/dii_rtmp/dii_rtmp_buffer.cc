@@ -37,9 +37,17 @@
 #define AUDIO_PACKET_TIME_LEN           10         // 10 ms   
 #define VIDEO_PACKET_TIME_LEN           66         // 40 ms
 #define BUFFERING_INTERVAL_LEN          1000
+#define BUFFER_READY_MIN_LEN            300
 
-DiiRtmpBuffer::DiiRtmpBuffer(int32_t stream_id, PlyBufferCallback&callback)
-	: callback_(callback)
+#define SYNC_INTERVAL_LEN               5          // audio master poll interval
+#define SYNC_MAX_SLEEP_LEN              20         // video master max sleep, wake up for new frame
+#define AUDIO_WAIT_LEN                  1000       // no audio after first video, use video master
+#define VIDEO_CLOCK_SPEED_UP            1.1f       // video master drift correction when cache too large
+#define TS_JUMP_LEN                     4000
+
+DiiRtmpBuffer::DiiRtmpBuffer(int32_t stream_id, PlyBufferCallback&callback, dii_media_kit::DiiMemoryAccount* account)
+	: mem_account_(account)
+	, callback_(callback)
 	, got_audio_(false)
     , cache_time_len_(0)
 	, first_pkt_real_ts_(0)
@@ -49,7 +57,7 @@ DiiRtmpBuffer::DiiRtmpBuffer(int32_t stream_id, PlyBufferCallback&callback)
     , pcm_packets_count_(0) {
         this->stream_id_ = stream_id;
         processing_ = true;
-        dii_rtc::Thread::Start();
+        // sync thread start with first video frame, audio only stream no need it.
 }
 
 DiiRtmpBuffer::~DiiRtmpBuffer()
@@ -97,13 +105,17 @@ void DiiRtmpBuffer::CacheH264Frame(PlyPacket* pkt, int type) {
     }
 
     dii_rtc::CritScope cs(&v_mtx_);
+    if (!sync_thread_started_) {
+        sync_thread_started_ = true;
+        dii_rtc::Thread::Start();
+    }
     int32_t size = (int32_t)h264_frame_queue_.size();
     if(size > 500) {
         DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "H264 sync queue too large, have " << size << "+ frames";
     }
        
     h264_frame_queue_.push(pkt);
-    if(!got_audio_) {
+    if(!got_audio_ && clock_source_ != ClockVideo) {
         cache_time_len_ = size * VIDEO_PACKET_TIME_LEN;
     }
     DII_LOG(LS_VERBOSE, stream_id_, DII_CODE_COMMON_INFO) << "Add h264 data to cache, buffer size: " << size;;
@@ -123,10 +135,25 @@ void DiiRtmpBuffer::CachePcmData(const uint8_t* pdata, int len, int sample_rate,
     // push packet
 	PlyPacket* pkt = new PlyPacket(false);
 	pkt->SetData(pdata, len, ts, sync_ts);
+	pkt->SetAccount(mem_account_, true);
    
 	dii_rtc::CritScope cs(&a_mtx_);
 	audio_pcm_queue_.push(pkt);
     int32_t size = (int32_t)audio_pcm_queue_.size();
+
+    // memory is tight, give up the enlarged jitter buffer and drop the oldest pcm.
+    if (dii_media_kit::DiiMemoryBudget::Instance()->Pressure() >= dii_media_kit::DII_MEM_PRESSURE_SHRINK_CACHE) {
+        buffer_ready_len_ = BUFFER_READY_MIN_LEN;
+        int32_t max_size = (buffer_ready_len_ + BUFFERING_INTERVAL_LEN) / AUDIO_PACKET_TIME_LEN;
+        if (size > max_size) {
+            DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "memory pressure, drop " << size - max_size << " pcm packets.";
+        }
+        while (size > max_size) {
+            delete audio_pcm_queue_.front();
+            audio_pcm_queue_.pop();
+            size--;
+        }
+    }
     cache_time_len_ = size * AUDIO_PACKET_TIME_LEN;
     if (cache_time_len_ <= BUFFERING_TIME_LEN && buffer_state_ != Buffering) {
         buffer_state_ = Buffering;
@@ -177,16 +204,40 @@ void DiiRtmpBuffer::ClearCache() {
 
 void DiiRtmpBuffer::Run() {
     while(processing_) {
-        dii_rtc::Thread::SleepMs(5);
-        DoSyncAudioVideo();
+        int32_t wait_ms = DoSyncAudioVideo();
+        dii_rtc::Thread::SleepMs(wait_ms);
     }
 }
 
-// audio and video sync
-void DiiRtmpBuffer::DoSyncAudioVideo()
+// audio master if have audio, otherwise video master.
+void DiiRtmpBuffer::UpdateClockSource() {
+    SyncClockSource source = clock_source_;
+    if (got_audio_) {
+        source = ClockAudio;
+    } else if (got_video_ && first_pkt_real_ts_ > 0
+               && dii_rtc::TimeMillis() - first_pkt_real_ts_ > AUDIO_WAIT_LEN) {
+        source = ClockVideo;
+    }
+
+    if (source != clock_source_) {
+        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "sync clock source changed: " << clock_source_ << " -> " << source;
+        clock_source_ = source;
+        if (source == ClockVideo) {
+            buffer_state_ = Buffering;
+        }
+    }
+}
+
+// audio and video sync, return ms to wait next sync.
+int32_t DiiRtmpBuffer::DoSyncAudioVideo()
 {
+    UpdateClockSource();
+    if (clock_source_ == ClockVideo) {
+        return DoSyncVideoClock();
+    }
+
     if (first_pkt_real_ts_ == 0 || buffer_state_ != BufferReady) {
-		return;
+		return SYNC_INTERVAL_LEN;
     }
     
     PlyPacket* pkt = NULL;
@@ -199,11 +250,73 @@ void DiiRtmpBuffer::DoSyncAudioVideo()
             if(dt <= 0) {
                 callback_.OnNeedDecodeFrame(pkt);
                 h264_frame_queue_.pop();
-            } else if(std::abs(dt) >= 4000) { //防止异常跳变的时间戳, 但对于连续跳变的时间戳，此逻辑无效
+            } else if(std::abs(dt) >= TS_JUMP_LEN) { //防止异常跳变的时间戳, 但对于连续跳变的时间戳，此逻辑无效
                 Thread::SleepMs(66);
                 callback_.OnNeedDecodeFrame(pkt);
                 h264_frame_queue_.pop();
             }
         }
     }
+    return SYNC_INTERVAL_LEN;
+}
+
+// video only stream, pace frames by pts against wall clock.
+int32_t DiiRtmpBuffer::DoSyncVideoClock()
+{
+    dii_rtc::CritScope cs(&v_mtx_);
+    if (h264_frame_queue_.empty()) {
+        cache_time_len_ = 0;
+        if (buffer_state_ != Buffering) {
+            buffer_state_ = Buffering;
+            caton_cnt_++;
+            if(caton_cnt_ >= 2) {
+                if(buffer_ready_len_ < 5000) {
+                    buffer_ready_len_ += 1000;
+                }
+                caton_cnt_ = 0;
+            }
+        }
+        return SYNC_MAX_SLEEP_LEN;
+    }
+
+    int64_t front_pts = h264_frame_queue_.front()->_pts;
+    int64_t back_pts = h264_frame_queue_.back()->_pts;
+    cache_time_len_ = (int32_t)std::abs(back_pts - front_pts);
+
+    int64_t now = dii_rtc::TimeMillis();
+    if (buffer_state_ != BufferReady) {
+        if (cache_time_len_ < buffer_ready_len_) {
+            return SYNC_MAX_SLEEP_LEN;
+        }
+        buffer_state_ = BufferReady;
+        video_clock_base_pts_ = front_pts;
+        video_clock_base_time_ = now;
+        video_clock_speed_ = 1.0;
+    }
+
+    // drift correction, source clock faster than local clock, cache grows.
+    float speed = cache_time_len_ > buffer_ready_len_ + BUFFERING_INTERVAL_LEN ? VIDEO_CLOCK_SPEED_UP : 1.0;
+    int64_t clock = video_clock_base_pts_ + (int64_t)((now - video_clock_base_time_) * video_clock_speed_);
+    if (speed != video_clock_speed_) {
+        video_clock_base_pts_ = clock;
+        video_clock_base_time_ = now;
+        video_clock_speed_ = speed;
+    }
+    if (std::abs(front_pts - clock) >= TS_JUMP_LEN) {
+        video_clock_base_pts_ = clock = front_pts;
+        video_clock_base_time_ = now;
+    }
+    sync_clock_ = clock;
+
+    while (!h264_frame_queue_.empty() && (int64_t)h264_frame_queue_.front()->_pts <= clock) {
+        callback_.OnNeedDecodeFrame(h264_frame_queue_.front());
+        h264_frame_queue_.pop();
+    }
+    if (h264_frame_queue_.empty()) {
+        return SYNC_MAX_SLEEP_LEN;
+    }
+
+    // sleep to due time of next frame, base is absolute so no drift accumulate.
+    int64_t wait_ms = (int64_t)((h264_frame_queue_.front()->_pts - clock) / video_clock_speed_);
+    return (int32_t)FFMIN(FFMAX(wait_ms, 1), SYNC_MAX_SLEEP_LEN);
 }
@@ -25,6 +25,7 @@
 #include "webrtc/base/criticalsection.h"
 #include "webrtc/base/scoped_ptr.h"
 #include "webrtc/base/thread.h"
+#include "dii_memory_budget.h"
 
 #include <list>
 #include <queue>
@@ -33,15 +34,25 @@
 
 typedef struct PlyPacket {
 	PlyPacket(bool isvideo) : _data(NULL), _data_len(0),
-							  _b_video(isvideo), _pts(0), _sync_ts(0) {}
+							  _b_video(isvideo), _pts(0), _sync_ts(0),
+							  _account(NULL), _decoded(false) {}
 
 	virtual ~PlyPacket(void){
+		Charge(-_data_len);
 		if (_data)
 			delete[] _data;
 	}
+	// bytes of _data are charged to account until packet deleted.
+	void SetAccount(dii_media_kit::DiiMemoryAccount* account, bool decoded) {
+		Charge(-_data_len);
+		_account = account;
+		_decoded = decoded;
+		Charge(_data_len);
+	}
 	void SetData(const uint8_t*pdata, int len, uint32_t ts) {
 		_pts = ts;
 		if (len > 0 && pdata != NULL) {
+			Charge(len - _data_len);
 			if (_data)
 				delete[] _data;
 			if (_b_video)
@@ -57,6 +68,7 @@ typedef struct PlyPacket {
         _pts = ts;
         _sync_ts = sync_ts;
         if (len > 0 && pdata != NULL) {
+            Charge(len - _data_len);
             if (_data)
                 delete[] _data;
             if (_b_video)
@@ -73,6 +85,18 @@ typedef struct PlyPacket {
 	bool _b_video;
 	uint32_t _pts;
     uint64_t _sync_ts;
+
+private:
+	void Charge(int64_t bytes) {
+		if (!_account || bytes == 0)
+			return;
+		if (_decoded)
+			_account->AddDecoded(bytes);
+		else
+			_account->AddCompressed(bytes);
+	}
+	dii_media_kit::DiiMemoryAccount* _account;
+	bool _decoded;
 } PlyPacket;
 
 enum BufferState {
@@ -80,6 +104,13 @@ enum BufferState {
     BufferReady,
 };
 
+// master clock to release video frames
+enum SyncClockSource {
+    ClockNone = 0,
+    ClockAudio,     // pts of playing pcm
+    ClockVideo,     // wall clock, video only stream
+};
+
 class PlyBufferCallback {
 public:
 	PlyBufferCallback(void){};
@@ -89,12 +120,13 @@ public:
 
 class DiiRtmpBuffer : public dii_rtc::Thread {
 public:
-	DiiRtmpBuffer(int32_t stream_id, PlyBufferCallback&callback);
+	DiiRtmpBuffer(int32_t stream_id, PlyBufferCallback&callback, dii_media_kit::DiiMemoryAccount* account = NULL);
 	virtual ~DiiRtmpBuffer();
 	int GetMorePcmData(void *audioSamples, size_t samplesPerSec, size_t nChannels, uint64_t &sync_ts);
     BufferState PlayerStatus(){return buffer_state_;};
 	int32_t GetPlayCacheTime(){return cache_time_len_;};
     int32_t PlayReadyBufferLen() const { return buffer_ready_len_;};
+    int64_t SyncClock() const { return sync_clock_; };
 	void CacheH264Frame(PlyPacket* pkt, int type); //dii_media_kit::VideoFrame* frame
 	void CachePcmData(const uint8_t* pdata, int len, int sample_rate, int channel_cnt, uint32_t ts, uint64_t sync_ts);
     void ClearCache();
@@ -103,11 +135,14 @@ private:
     //* For Thread
     virtual void Run() override;
     
-	void DoSyncAudioVideo();
+	int32_t DoSyncAudioVideo();
+	int32_t DoSyncVideoClock();
+	void UpdateClockSource();
     void InitSoundTouch(uint16_t sample_rate, uint8_t channel_count);
 private:
     int32_t stream_id_ = 0;
     bool                    processing_ = false;
+    dii_media_kit::DiiMemoryAccount* mem_account_ = NULL;
     
     dii_rtc::CriticalSection a_mtx_;
     dii_rtc::CriticalSection v_mtx_;
@@ -122,6 +157,13 @@ private:
 	int64_t				    first_rtmp_pkt_ts_ = 0;
 	int64_t				    rtmp_cache_time_ = 0;
 	int64_t                 sync_clock_ = 0;
+	SyncClockSource         clock_source_ = ClockNone;
+	bool                    sync_thread_started_ = false;
+
+	// video master clock: pts = base_pts + (now - base_time) * speed
+	int64_t                 video_clock_base_pts_ = 0;
+	int64_t                 video_clock_base_time_ = 0;
+	float                   video_clock_speed_ = 1.0;
 
 	std::queue<PlyPacket*>	audio_pcm_queue_;
 
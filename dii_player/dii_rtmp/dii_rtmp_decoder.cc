@@ -22,7 +22,28 @@
 #include "webrtc/common_video/libyuv/include/webrtc_libyuv.h"
 #include "dii_media_utils.h"
 
+// video frame late to audio clock
+#define VIDEO_LATE_SKIP_NONREF_MS       80      // drop non-reference frame
+#define VIDEO_LATE_SKIP_TO_IDR_MS       500     // drop all until next idr
+#define VIDEO_LATE_MAX_MS               4000    // abnormal timestamp, ignore
+
 namespace dii_media_kit {
+// header byte of first slice nal (type 1 or 5) in annexb access unit, -1 if none.
+// access unit may start with aud, sei, sps or pps, whose nal_ref_idc tells nothing.
+static int FirstVclNalHeader(const uint8_t* data, int len) {
+    for (int i = 0; i + 3 < len; i++) {
+        if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1) {
+            continue;
+        }
+        int type = data[i + 3] & 0x1f;
+        if (type == 1 || type == 5) {
+            return data[i + 3];
+        }
+        i += 2;
+    }
+    return -1;
+}
+
 #ifndef WEBRTC_WIN
 enum Frametype {
     FRAME_I  = 15,
@@ -132,11 +153,14 @@ DiiRtmpDecoder::DiiRtmpDecoder(int32_t stream_id, bool report)
     , _report(report)
 {
         this->stream_id_ = stream_id;
+        mem_account_ = DiiMemoryBudget::Instance()->CreateAccount(stream_id);
 }
 
 DiiRtmpDecoder::~DiiRtmpDecoder()
 {
     this->Shutdown();
+    DiiMemoryBudget::Instance()->ReleaseAccount(mem_account_);
+    mem_account_ = nullptr;
     if(_userId){
         free(_userId);
         _userId = NULL;
@@ -149,6 +173,7 @@ void DiiRtmpDecoder::Start(bool report) {
     }
     _report = report;
     got_keyframe_ = false;
+    skip_to_idr_ = false;
     h264_decoder_ = dii_media_kit::H264Decoder::Create();
     dii_media_kit::VideoCodec codecSetting;
     codecSetting.codecType = dii_media_kit::kVideoCodecH264;
@@ -160,7 +185,7 @@ void DiiRtmpDecoder::Start(bool report) {
     running_ = true;
     
 //    last_statistic_ts_ = dii_rtc::Time();
-    ply_buffer_ = new DiiRtmpBuffer(stream_id_, *this);
+    ply_buffer_ = new DiiRtmpBuffer(stream_id_, *this, mem_account_);
     v_decode_thread_ = new std::thread(&DiiRtmpDecoder::VideoDecodeThread, this);
     a_decode_thread_ = new std::thread(&DiiRtmpDecoder::AudioDecodeThread, this);
     
@@ -233,12 +258,13 @@ int32_t DiiRtmpDecoder::GetCacheTime() {
     return cache_len;
 }
 
-void DiiRtmpDecoder::CacheAvcData(const uint8_t* pdata, int len, uint32_t ts)
+void DiiRtmpDecoder::CacheAvcData(const uint8_t* pdata, int len, uint32_t ts, uint64_t sync_ts)
 {
     video_bitrate_ += len;
 
     PlyPacket* pkt = new PlyPacket(true);
-    pkt->SetData(pdata, len, ts);
+    pkt->SetData(pdata, len, ts, sync_ts);
+    pkt->SetAccount(mem_account_, false);
 
 #ifndef WEBRTC_WIN
     bs_t s;
@@ -267,6 +293,7 @@ void DiiRtmpDecoder::CacheAvcData(const uint8_t* pdata, int len, uint32_t ts)
     }
     if(ft == FRAME_B) {
         DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "Not support decode P video frame, drop it.";
+        delete pkt;
         return;
     }
 #endif
@@ -278,6 +305,16 @@ void DiiRtmpDecoder::CacheAvcData(const uint8_t* pdata, int len, uint32_t ts)
     
     if(!got_keyframe_) {
         DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "Not keyframe. Drop it before keyframe coming.";
+        delete pkt;
+        return;
+    }
+
+    // nal_ref_idc == 0, nobody reference it, drop it when memory is tight, never idr.
+    int vcl = FirstVclNalHeader(pkt->_data, pkt->_data_len);
+    bool nonref = vcl >= 0 && (vcl & 0x1f) != 5 && ((vcl >> 5) & 0x03) == 0;
+    if (nonref && DiiMemoryBudget::Instance()->Pressure() >= DII_MEM_PRESSURE_DROP_NONREF) {
+        mem_dropped_frames_++;
+        delete pkt;
         return;
     }
     
@@ -401,6 +438,7 @@ void DiiRtmpDecoder::CacheAacData(const uint8_t*pdata, int len, uint32_t ts, uin
     // push packet
     PlyPacket* pkt = new PlyPacket(false);
     pkt->SetData(pdata, len, ts, sync_ts);
+    pkt->SetAccount(mem_account_, false);
     std::unique_lock<std::mutex> lck(a_mtx_);
     aac_queue_.push(pkt);
     a_cond_.notify_one();
@@ -478,6 +516,12 @@ void DiiRtmpDecoder::VideoDecodeThread() {
             if(!pkt)
                 continue;
         }
+
+        if (NeedSkipVideoFrame(pkt)) {
+            late_dropped_frames_++;
+            delete pkt;
+            continue;
+        }
      
         int frameType = pkt->_data[4] & 0x1f;
         dii_media_kit::EncodedImage encoded_image;
@@ -485,6 +529,8 @@ void DiiRtmpDecoder::VideoDecodeThread() {
         encoded_image._length = pkt->_data_len;
         encoded_image._size = pkt->_data_len + 8;
         encoded_image._timeStamp = pkt->_pts;
+        // decoder carry it to decoded frame.
+        encoded_image.ntp_time_ms_ = pkt->_sync_ts;
         if (frameType == 7) {
             encoded_image._frameType = dii_media_kit::kVideoFrameKey;
         }
@@ -495,7 +541,9 @@ void DiiRtmpDecoder::VideoDecodeThread() {
         dii_media_kit::RTPFragmentationHeader frag_info;
      
         decode_fps_++;
+        int64_t decode_start = dii_rtc::TimeMillis();
         int ret = h264_decoder_->Decode(encoded_image, false, &frag_info);
+        decode_time_ms_ += dii_rtc::TimeMillis() - decode_start;
         if (ret != 0) {
             DII_LOG(LS_INFO, stream_id_, 2002009) << "rtmp h264 decode error.with error code:"<<ret;
         }
@@ -503,6 +551,37 @@ void DiiRtmpDecoder::VideoDecodeThread() {
 	}
 }
 
+// decoder can't catch up with audio clock, shed load, recover when catch up.
+bool DiiRtmpDecoder::NeedSkipVideoFrame(PlyPacket* pkt) {
+    int vcl = FirstVclNalHeader(pkt->_data, pkt->_data_len);
+    bool idr = (pkt->_data[4] & 0x1f) == 7 || (vcl >= 0 && (vcl & 0x1f) == 5);
+    if (skip_to_idr_) {
+        if (!idr) {
+            return true;
+        }
+        skip_to_idr_ = false;
+        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "video decode catch up at idr, dropped frames: " << late_dropped_frames_.load();
+        return false;
+    }
+
+    if (!ply_buffer_) {
+        return false;
+    }
+    int64_t late = ply_buffer_->SyncClock() - pkt->_pts;
+    if (late <= VIDEO_LATE_SKIP_NONREF_MS || late >= VIDEO_LATE_MAX_MS) {
+        return false;
+    }
+
+    if (late >= VIDEO_LATE_SKIP_TO_IDR_MS && !idr) {
+        skip_to_idr_ = true;
+        DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "video decode late " << late << " ms, skip to next idr.";
+        return true;
+    }
+
+    // nal_ref_idc == 0 of slice, not of leading sei / aud.
+    return !idr && vcl >= 0 && ((vcl >> 5) & 0x03) == 0;
+}
+
 // decode video data
 void DiiRtmpDecoder::OnNeedDecodeFrame(PlyPacket* pkt) {
     std::unique_lock<std::mutex> vlck(v_mtx_);
@@ -576,6 +655,20 @@ void DiiRtmpDecoder::DoStatistics(DiiPlayerStatistics& statistics) {
     statistics.video_height_            = frame_height_;
 
     statistics.sync_ts_ = cur_sync_ts_;
+    statistics.memory_dropped_frames_ = mem_dropped_frames_;
+    statistics.video_late_dropped_frames_ = late_dropped_frames_.load();
+
+    // percent of time decode thread is idle since last statistics.
+    int64_t now = dii_rtc::TimeMillis();
+    int64_t elapsed = now - last_statistic_ts_;
+    if (last_statistic_ts_ > 0 && elapsed > 0) {
+        int64_t headroom = 100 - decode_time_ms_.exchange(0) * 100 / elapsed;
+        statistics.video_decode_headroom_ = (int32_t)(headroom < 0 ? 0 : headroom);
+    } else {
+        statistics.video_decode_headroom_ = 100;
+        decode_time_ms_ = 0;
+    }
+    last_statistic_ts_ = now;
     
     audio_bitrate_ = 0;
     video_bitrate_ = 0;
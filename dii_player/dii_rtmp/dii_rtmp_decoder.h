@@ -22,6 +22,7 @@
 #include "pluginaac.h"
 #include "dii_common.h"
 #include "dii_play_base.h"
+#include "dii_memory_budget.h"
 #include "webrtc/base/thread.h"
 #include "webrtc/common_audio/ring_buffer.h"
 #include "webrtc/modules/audio_coding/acm2/acm_resampler.h"
@@ -30,6 +31,7 @@
 #include "webrtc/modules/video_coding/codecs/h264/include/h264.h"
 #include "webrtc/api/mediastreaminterface.h"
 #include "third_party/SoundTouch/SoundTouch/SoundTouch.h"
+#include <atomic>
 
 extern "C" {
     #include "libavutil/avstring.h"
@@ -74,7 +76,7 @@ namespace dii_media_kit {
         bool IsPlaying();
         int32_t  GetCacheTime();
 
-        void CacheAvcData(const uint8_t*pdata, int len, uint32_t ts);
+        void CacheAvcData(const uint8_t*pdata, int len, uint32_t ts, uint64_t sync_ts);
         void CacheAacData(const uint8_t*pdata, int len, uint32_t ts, uint64_t sync_ts);
         int GetMorePcmData(void *audioSamples, size_t samplesPerSec, size_t nChannels, uint64_t &sync_ts);
         void ClearCache();
@@ -89,6 +91,7 @@ namespace dii_media_kit {
         void InitSoundTouch(uint16_t sample_rate, uint8_t channel_count);
         void DoSoundtouch(uint8_t*data, int32_t len);
         void ChunkAndCacheAudioData(uint32_t pts, uint64_t sync_ts );
+        bool NeedSkipVideoFrame(PlyPacket* pkt);
     private:
         int32_t stream_id_ = -1;
         // video decode thread
@@ -136,6 +139,16 @@ namespace dii_media_kit {
         VideoFrameCallback video_frame_callback_ = nullptr;
         
         uint32_t pre_pts_ = 0;
+
+        // decode shedding, video frame late to audio clock
+        bool        skip_to_idr_ = false;
+        // written on decode thread, read on timer wheel thread.
+        std::atomic<int32_t> late_dropped_frames_{0};
+        std::atomic<int64_t> decode_time_ms_{0};
+
+        // memory budget
+        DiiMemoryAccount* mem_account_ = nullptr;
+        int32_t mem_dropped_frames_ = 0;
         
         // soundtouch
         dii_soundtouch::SoundTouch *sound_touch_ = nullptr;
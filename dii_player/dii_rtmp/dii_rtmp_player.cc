@@ -20,6 +20,7 @@
 #include "dii_audio_manager.h"
 #include "srs_librtmp.h"
 #include "dii_media_utils.h"
+#include "dii_timer_wheel.h"
 #include "webrtc/base/logging.h"
 #include "webrtc/media/base/videoframe.h"
 
@@ -40,6 +41,7 @@ DiiRtmplayer::DiiRtmplayer(int32_t stream_id) {
 
 DiiRtmplayer::~DiiRtmplayer(void)
 {
+    DiiTimerWheel::GetInstance()->Cancel(repull_timer_id_);
     dii_rtc::Thread::Clear(this, DII_MSG_REPULL);
     dii_rtc::Thread::Stop();
     if (rtmp_puller_) {
@@ -131,9 +133,9 @@ int32_t DiiRtmplayer::SetCallback(DiiMediaBaseCallback callback) {
     return 0;
 }
 
-void DiiRtmplayer::OnPullVideoData(const uint8_t*pdata, int len, uint32_t ts) {
+void DiiRtmplayer::OnPullVideoData(const uint8_t*pdata, int len, uint32_t ts, uint64_t sync_ts) {
 	if (av_decoder_) {
-        av_decoder_->CacheAvcData(pdata, len, ts);
+        av_decoder_->CacheAvcData(pdata, len, ts, sync_ts);
 	}
 }
 
@@ -158,7 +160,12 @@ void DiiRtmplayer::OnPullFailed(int32_t errCode,int32_t eventid,const char * err
     if(running_) {
         need_callback_ = true;
 
-        dii_rtc::Thread::PostDelayed(RTC_FROM_HERE, 1000, this, DII_MSG_REPULL);
+        // delay by shared timer wheel, repull still run on this thread.
+        std::shared_ptr<DiiTimerWheel> timer_wheel = DiiTimerWheel::GetInstance();
+        timer_wheel->Cancel(repull_timer_id_);
+        repull_timer_id_ = timer_wheel->Schedule(1000, [this]() {
+            dii_rtc::Thread::Post(RTC_FROM_HERE, this, DII_MSG_REPULL);
+        });
         retry_cnt_++;  
 		DII_LOG(LS_ERROR, stream_id_, eventid) << "rtmp repull url:" << url_ << errmsg << " ,err code:" << errCode;
         if(retry_cnt_%3 != 0) {
@@ -39,6 +39,8 @@ public:
 	int32_t Start(const char* url, int64_t pos = 0, bool pause = false) override;
     int32_t StopPlay() override;
     int32_t SetLoop(bool loop) override {return 0;};
+    int32_t SetPlaybackRate(float rate) override {return -1;};
+    int32_t SelectAudioTrack(int32_t index) override {return -1;};
     int32_t GetMoreAudioData(void *stream, size_t sample_rate, size_t channel) override;
     int32_t SetCallback(DiiMediaBaseCallback callback) override;
     void DoStatistics(DiiPlayerStatistics& statistics) override;
@@ -52,7 +54,7 @@ public:
 protected:
 	void OnServerConnected() override;
     void OnPullFailed(int32_t errCode, int32_t eventid, const char * errmsg) override;
-	void OnPullVideoData(const uint8_t*pdata, int len, uint32_t ts) override;
+	void OnPullVideoData(const uint8_t*pdata, int len, uint32_t ts, uint64_t sync_ts) override;
 	void OnPullAudioData(const uint8_t*pdata, int len, uint32_t ts, uint64_t sync_ts) override;
 private:
     //* For MessageHandler
@@ -69,6 +71,7 @@ private:
 	std::string			url_;
     uint64_t            previous_sync_ts_ = 0;
     int32_t             retry_cnt_ = 0;
+    int64_t             repull_timer_id_ = 0;
                             
     bool need_callback_ = true;
                             
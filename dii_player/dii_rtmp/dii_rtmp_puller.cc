@@ -19,6 +19,7 @@
 #include "dii_rtmp_puller.h"
 #include "srs_librtmp.h"
 #include "dii_media_utils.h"
+#include "dii_memory_budget.h"
 #include "webrtc/base/logging.h"
 #include "webrtc/base/thread.h"
 
@@ -29,6 +30,9 @@
 #define RTMP_READ_TIME_OUT    10000  //ms
 #define RTMP_WRITE_TIME_OUT   10000  //ms
 
+// memory pressure, pause read only if stream cached more than it.
+#define PAUSE_READ_MIN_CACHE_BYTES  (256 * 1024)
+
 
 #define ERR_CODE_UNKNOW                     99
 #define ERR_CODE_HANDSHARK                  100
@@ -188,13 +192,20 @@ void DiiRtmpPuller::Run()
 					sleeptimestamp_ms = 200;
                 }
 			}else if(RS_PLY_Played == rtmp_status_){
-                ret = DoReadData();
-				if (ret == 0) {
-					need_sleep = false;
-				}
-				else {
-					connect_error_count++;
+				// memory is exhausted, stop reading socket until cache consumed.
+				// keep reading if this stream has nearly nothing cached, avoid starving.
+				if (dii_media_kit::DiiMemoryBudget::Instance()->Pressure() >= dii_media_kit::DII_MEM_PRESSURE_PAUSE_READ
+					&& dii_media_kit::DiiMemoryBudget::Instance()->StreamUsage(stream_id_) > PAUSE_READ_MIN_CACHE_BYTES) {
 					need_sleep = true;
+				} else {
+					ret = DoReadData();
+					if (ret == 0) {
+						need_sleep = false;
+					}
+					else {
+						connect_error_count++;
+						need_sleep = true;
+					}
 				}
 			}
 		}
@@ -307,11 +318,7 @@ int32_t DiiRtmpPuller::DoReadData()
             rtmp_metadata_packet_ts_ = timestamp;
         }
         
-        uint64_t sync_ts = 0;
-        if(metadata_sync_ts_ > 0) {
-            uint64_t delta_ts = timestamp - rtmp_metadata_packet_ts_;
-            sync_ts = metadata_sync_ts_ + delta_ts;
-        }
+        uint64_t sync_ts = SyncTimestamp(timestamp);
         lastest_audio_ts_ = timestamp;
 		GotAudioSample(timestamp, &sample, sync_ts);
         audio_bitrate_ += size;
@@ -422,7 +429,7 @@ int DiiRtmpPuller::GotVideoSample(uint32_t timestamp, SrsCodecSample *sample)
 	}
 	//* Fix for mutil nalu.
 	if (video_payload_->_data_len != 0) {
-        callback_.OnPullVideoData((uint8_t *) video_payload_->_data, video_payload_->_data_len, timestamp);
+        callback_.OnPullVideoData((uint8_t *) video_payload_->_data, video_payload_->_data_len, timestamp, SyncTimestamp(timestamp));
 	}
 	video_payload_->reset();
 
@@ -552,18 +559,28 @@ void DiiRtmpPuller::RescanVideoframe(const char*pdata, int len, uint32_t timesta
         video_payload_->append(ptr8, size8);
         video_payload_->append((const char*)fresh_nalu_header, 4);
         video_payload_->append(ptr5, size5);
-        callback_.OnPullVideoData((uint8_t *) video_payload_->_data, video_payload_->_data_len, timestamp);
+        callback_.OnPullVideoData((uint8_t *) video_payload_->_data, video_payload_->_data_len, timestamp, SyncTimestamp(timestamp));
         video_payload_->reset();
     }
     else 
     {
         video_payload_->append(pdata, len);
-        callback_.OnPullVideoData((uint8_t *) video_payload_->_data, video_payload_->_data_len, timestamp);
+        callback_.OnPullVideoData((uint8_t *) video_payload_->_data, video_payload_->_data_len, timestamp, SyncTimestamp(timestamp));
         video_payload_->reset();
     }
 }
 
 
+// audio and video share rtmp timeline, map packet timestamp to metadata sync timestamp.
+uint64_t DiiRtmpPuller::SyncTimestamp(uint32_t timestamp)
+{
+    if (metadata_sync_ts_ == 0) {
+        return 0;
+    }
+    int64_t delta_ts = (int64_t)timestamp - (int64_t)rtmp_metadata_packet_ts_;
+    return metadata_sync_ts_ + delta_ts;
+}
+
 void DiiRtmpPuller::CallConnect()
 {
     callback_.OnServerConnected();
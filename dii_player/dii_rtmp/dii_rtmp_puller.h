@@ -64,7 +64,7 @@ public:
 
 	virtual void OnServerConnected() = 0;
 	virtual void OnPullFailed(int32_t errCode, int32_t eventid, const char * errmsg) = 0;
-	virtual void OnPullVideoData(const uint8_t*pdata, int len, uint32_t ts) = 0;
+	virtual void OnPullVideoData(const uint8_t*pdata, int len, uint32_t ts, uint64_t sync_ts) = 0;
 	virtual void OnPullAudioData(const uint8_t*pdata, int len, uint32_t ts, uint64_t sync_ts) = 0;
 };
 
@@ -82,6 +82,7 @@ protected:
 	int GotVideoSample(uint32_t timestamp, SrsCodecSample *sample);
 	int GotAudioSample(uint32_t timestamp, SrsCodecSample *sample, uint64_t sync_ts);
     void RescanVideoframe(const char*pdata, int len, uint32_t timestamp);
+    uint64_t SyncTimestamp(uint32_t timestamp);
 
 	void CallConnect();
 
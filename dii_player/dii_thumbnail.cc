@@ -0,0 +1,375 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_thumbnail.h"
+#include "dii_com_def.h"
+#include "webrtc/base/logging.h"
+#include "third_party/libyuv/include/libyuv.h"
+
+#include <algorithm>
+
+extern "C" {
+    #include "libavformat/avformat.h"
+    #include "libavcodec/avcodec.h"
+    #include "libswscale/swscale.h"
+}
+
+#define THUMBNAIL_WORKERS           2
+#define THUMBNAIL_MIN_TASK_SIZE     4       // timestamps per task at least
+#define THUMBNAIL_CACHE_MAX_BYTES   (32 * 1024 * 1024)
+#define THUMBNAIL_MAX_READ_PACKETS  2000    // give up if no keyframe after seek
+
+namespace dii_media_kit {
+
+/* keyframe only decoder of one file, used by one worker at a time. */
+class DiiThumbnailDecoder {
+public:
+    DiiThumbnailDecoder() {}
+    ~DiiThumbnailDecoder() {
+        avcodec_free_context(&avctx_);
+        avformat_close_input(&ic_);
+        sws_freeContext(sws_ctx_);
+    }
+
+    int32_t Open(const char* url, int32_t width) {
+        if (avformat_open_input(&ic_, url, NULL, NULL) < 0) {
+            return DII_ERROR;
+        }
+        if (avformat_find_stream_info(ic_, NULL) < 0) {
+            return DII_ERROR;
+        }
+
+        AVCodec* codec = NULL;
+        stream_ = av_find_best_stream(ic_, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+        if (stream_ < 0 || !codec) {
+            return DII_ERROR;
+        }
+        for (unsigned int i = 0; i < ic_->nb_streams; i++) {
+            ic_->streams[i]->discard = AVDISCARD_ALL;
+        }
+        AVStream* st = ic_->streams[stream_];
+        st->discard = AVDISCARD_NONKEY;
+
+        avctx_ = avcodec_alloc_context3(codec);
+        if (!avctx_ || avcodec_parameters_to_context(avctx_, st->codecpar) < 0) {
+            return DII_ERROR;
+        }
+        avctx_->pkt_timebase = st->time_base;
+        avctx_->thread_count = 1;
+        avctx_->skip_frame = AVDISCARD_NONKEY;
+
+        // decode at reduced size when the codec can, but not smaller than thumbnail
+        int lowres = 0;
+        while (width > 0 && lowres < codec->max_lowres && (avctx_->width >> (lowres + 1)) >= width) {
+            lowres++;
+        }
+        avctx_->lowres = lowres;
+
+        if (avcodec_open2(avctx_, codec, NULL) < 0) {
+            return DII_ERROR;
+        }
+        return DII_DONE;
+    }
+
+    // ts in ms from start, keyframe_ts is the ms of decoded keyframe.
+    dii_rtc::scoped_refptr<I420Buffer> Decode(int64_t ts, int32_t width, int32_t height, int64_t* keyframe_ts) {
+        int64_t start_time = ic_->start_time != AV_NOPTS_VALUE ? ic_->start_time : 0;
+        int64_t target = ts * 1000 + start_time;
+        if (avformat_seek_file(ic_, -1, INT64_MIN, target, target, 0) < 0 &&
+            avformat_seek_file(ic_, -1, INT64_MIN, target, INT64_MAX, 0) < 0) {
+            return nullptr;
+        }
+        avcodec_flush_buffers(avctx_);
+
+        AVFrame* frame = av_frame_alloc();
+        AVPacket pkt;
+        int got = 0;
+        for (int i = 0; i < THUMBNAIL_MAX_READ_PACKETS && !got; i++) {
+            if (av_read_frame(ic_, &pkt) < 0) {
+                break;
+            }
+            if (pkt.stream_index != stream_ || !(pkt.flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(&pkt);
+                continue;
+            }
+            int ret = avcodec_send_packet(avctx_, &pkt);
+            av_packet_unref(&pkt);
+            if (ret < 0) {
+                continue;
+            }
+            // drain, decoder may delay output even for a single keyframe.
+            avcodec_send_packet(avctx_, NULL);
+            got = avcodec_receive_frame(avctx_, frame) == 0;
+            if (!got) {
+                avcodec_flush_buffers(avctx_);
+            }
+        }
+
+        dii_rtc::scoped_refptr<I420Buffer> buffer;
+        if (got) {
+            AVRational ms = { 1, 1000 };
+            int64_t pts = frame->best_effort_timestamp;
+            *keyframe_ts = pts == AV_NOPTS_VALUE ? ts
+                           : av_rescale_q(pts, ic_->streams[stream_]->time_base, ms) - start_time / 1000;
+            buffer = Scale(frame, width, height);
+        }
+        av_frame_free(&frame);
+        return buffer;
+    }
+
+private:
+    dii_rtc::scoped_refptr<I420Buffer> Scale(AVFrame* frame, int32_t width, int32_t height) {
+        if (frame->width <= 0 || frame->height <= 0) {
+            return nullptr;
+        }
+        // keep aspect ratio when only one side is given
+        if (width <= 0 && height <= 0) {
+            width = frame->width;
+            height = frame->height;
+        } else if (width <= 0) {
+            width = (int32_t)((int64_t)height * frame->width / frame->height) & ~1;
+        } else if (height <= 0) {
+            height = (int32_t)((int64_t)width * frame->height / frame->width) & ~1;
+        }
+        if (width <= 0 || height <= 0) {
+            return nullptr;
+        }
+
+        const uint8_t* src[3] = { frame->data[0], frame->data[1], frame->data[2] };
+        int src_stride[3] = { frame->linesize[0], frame->linesize[1], frame->linesize[2] };
+        dii_rtc::scoped_refptr<I420Buffer> i420;
+        if (frame->format != AV_PIX_FMT_YUV420P && frame->format != AV_PIX_FMT_YUVJ420P) {
+            sws_ctx_ = sws_getCachedContext(sws_ctx_, frame->width, frame->height, (AVPixelFormat)frame->format,
+                                            frame->width, frame->height, AV_PIX_FMT_YUV420P,
+                                            SWS_FAST_BILINEAR, NULL, NULL, NULL);
+            if (!sws_ctx_) {
+                return nullptr;
+            }
+            i420 = I420Buffer::Create(frame->width, frame->height);
+            uint8_t* dst[4] = { i420->MutableDataY(), i420->MutableDataU(), i420->MutableDataV(), NULL };
+            int dst_stride[4] = { i420->StrideY(), i420->StrideU(), i420->StrideV(), 0 };
+            sws_scale(sws_ctx_, (const uint8_t* const*)frame->data, frame->linesize, 0, frame->height, dst, dst_stride);
+            src[0] = i420->DataY(); src[1] = i420->DataU(); src[2] = i420->DataV();
+            src_stride[0] = i420->StrideY(); src_stride[1] = i420->StrideU(); src_stride[2] = i420->StrideV();
+        }
+
+        dii_rtc::scoped_refptr<I420Buffer> buffer = I420Buffer::Create(width, height);
+        dii_libyuv::I420Scale(src[0], src_stride[0],
+                              src[1], src_stride[1],
+                              src[2], src_stride[2],
+                              frame->width, frame->height,
+                              buffer->MutableDataY(), buffer->StrideY(),
+                              buffer->MutableDataU(), buffer->StrideU(),
+                              buffer->MutableDataV(), buffer->StrideV(),
+                              width, height,
+                              dii_libyuv::kFilterBox);
+        return buffer;
+    }
+
+private:
+    AVFormatContext*    ic_ = nullptr;
+    AVCodecContext*     avctx_ = nullptr;
+    struct SwsContext*  sws_ctx_ = nullptr;
+    int                 stream_ = -1;
+};
+
+std::shared_ptr<DiiThumbnailExtractor> DiiThumbnailExtractor::thumbnail_ins_ = nullptr;
+std::mutex DiiThumbnailExtractor::ins_mtx_;
+std::shared_ptr<DiiThumbnailExtractor> DiiThumbnailExtractor::GetInstance() {
+    std::unique_lock<std::mutex> lck(ins_mtx_);
+    if (thumbnail_ins_.get() == nullptr) {
+        thumbnail_ins_.reset(new DiiThumbnailExtractor());
+    }
+    return thumbnail_ins_;
+}
+
+DiiThumbnailExtractor::DiiThumbnailExtractor() {
+}
+
+DiiThumbnailExtractor::~DiiThumbnailExtractor() {
+    {
+        std::unique_lock<std::mutex> lck(task_mtx_);
+        running_ = false;
+        tasks_.clear();
+        task_cond_.notify_all();
+    }
+    for (auto worker : workers_) {
+        if (worker->joinable()) {
+            worker->join();
+        }
+        delete worker;
+    }
+    workers_.clear();
+}
+
+int32_t DiiThumbnailExtractor::GetThumbnails(const char* url,
+                                             const int64_t* timestamps,
+                                             int32_t count,
+                                             int32_t width,
+                                             int32_t height,
+                                             DiiThumbnailCallback callback) {
+    if (!url || !timestamps || count <= 0 || !callback) {
+        return DII_PARAMETER_ERROR;
+    }
+
+    std::vector<int64_t> pending;
+    for (int32_t i = 0; i < count; i++) {
+        dii_rtc::scoped_refptr<I420Buffer> buffer = LookupCache(url, timestamps[i], width, height);
+        if (buffer) {
+            Deliver(callback, timestamps[i], 0, buffer);
+        } else {
+            pending.push_back(timestamps[i]);
+        }
+    }
+    if (pending.empty()) {
+        return DII_DONE;
+    }
+
+    // seek forward only inside a task, split into contiguous ranges for workers.
+    std::sort(pending.begin(), pending.end());
+    size_t nb_tasks = (pending.size() + THUMBNAIL_MIN_TASK_SIZE - 1) / THUMBNAIL_MIN_TASK_SIZE;
+    nb_tasks = std::min(nb_tasks, (size_t)THUMBNAIL_WORKERS);
+    size_t per_task = (pending.size() + nb_tasks - 1) / nb_tasks;
+
+    std::unique_lock<std::mutex> lck(task_mtx_);
+    if (!running_) {
+        running_ = true;
+        for (int i = 0; i < THUMBNAIL_WORKERS; i++) {
+            workers_.push_back(new std::thread(&DiiThumbnailExtractor::WorkerLoop, this));
+        }
+    }
+    for (size_t i = 0; i < pending.size(); i += per_task) {
+        Task task;
+        task.url = url;
+        task.width = width;
+        task.height = height;
+        task.callback = callback;
+        task.timestamps.assign(pending.begin() + i, pending.begin() + std::min(i + per_task, pending.size()));
+        tasks_.push_back(task);
+    }
+    task_cond_.notify_all();
+    return DII_DONE;
+}
+
+void DiiThumbnailExtractor::WorkerLoop() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lck(task_mtx_);
+            task_cond_.wait(lck, [this]() { return !running_ || !tasks_.empty(); });
+            if (!running_) {
+                break;
+            }
+            task = tasks_.front();
+            tasks_.pop_front();
+        }
+        RunTask(task);
+    }
+}
+
+void DiiThumbnailExtractor::RunTask(Task& task) {
+    DiiThumbnailDecoder decoder;
+    if (decoder.Open(task.url.c_str(), task.width) != DII_DONE) {
+        LOG(LS_WARNING) << "thumbnail open failed, url: " << task.url;
+        for (auto ts : task.timestamps) {
+            Deliver(task.callback, ts, DII_CODE_COMMON_ERROR, nullptr);
+        }
+        return;
+    }
+
+    for (auto ts : task.timestamps) {
+        // neighbour request may have decoded the same keyframe already
+        dii_rtc::scoped_refptr<I420Buffer> buffer = LookupCache(task.url, ts, task.width, task.height);
+        if (!buffer) {
+            int64_t keyframe_ts = ts;
+            buffer = decoder.Decode(ts, task.width, task.height, &keyframe_ts);
+            if (buffer) {
+                InsertCache(task.url, ts, keyframe_ts, task.width, task.height, buffer);
+            }
+        }
+        Deliver(task.callback, ts, buffer ? 0 : DII_CODE_COMMON_ERROR, buffer);
+    }
+}
+
+dii_rtc::scoped_refptr<I420Buffer> DiiThumbnailExtractor::LookupCache(const std::string& url, int64_t ts,
+                                                                     int32_t width, int32_t height) {
+    std::unique_lock<std::mutex> lck(cache_mtx_);
+    for (auto it = cache_.begin(); it != cache_.end(); ++it) {
+        if (it->width == width && it->height == height &&
+            it->keyframe_ts <= ts && ts <= it->covered_ts && it->url == url) {
+            cache_.splice(cache_.begin(), cache_, it);
+            return cache_.front().buffer;
+        }
+    }
+    return nullptr;
+}
+
+void DiiThumbnailExtractor::InsertCache(const std::string& url, int64_t ts, int64_t keyframe_ts,
+                                        int32_t width, int32_t height,
+                                        const dii_rtc::scoped_refptr<I420Buffer>& buffer) {
+    std::unique_lock<std::mutex> lck(cache_mtx_);
+    for (auto it = cache_.begin(); it != cache_.end(); ++it) {
+        if (it->width == width && it->height == height &&
+            it->keyframe_ts == keyframe_ts && it->url == url) {
+            it->covered_ts = std::max(it->covered_ts, ts);
+            cache_.splice(cache_.begin(), cache_, it);
+            return;
+        }
+    }
+
+    CacheEntry entry;
+    entry.url = url;
+    entry.width = width;
+    entry.height = height;
+    entry.keyframe_ts = keyframe_ts;
+    // seek may land after target when container can not seek backward
+    entry.covered_ts = std::max(ts, keyframe_ts);
+    entry.buffer = buffer;
+    cache_.push_front(entry);
+    cache_bytes_ += buffer->StrideY() * buffer->height() + (buffer->StrideU() + buffer->StrideV()) * ((buffer->height() + 1) / 2);
+
+    while (cache_bytes_ > THUMBNAIL_CACHE_MAX_BYTES && cache_.size() > 1) {
+        const dii_rtc::scoped_refptr<I420Buffer>& last = cache_.back().buffer;
+        cache_bytes_ -= last->StrideY() * last->height() + (last->StrideU() + last->StrideV()) * ((last->height() + 1) / 2);
+        cache_.pop_back();
+    }
+}
+
+void DiiThumbnailExtractor::Deliver(const DiiThumbnailCallback& callback, int64_t ts, int32_t code,
+                                    const dii_rtc::scoped_refptr<I420Buffer>& buffer) {
+    if (!buffer) {
+        callback(ts, code, nullptr);
+        return;
+    }
+    DiiVideoFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.type = TYPE_YUV420;
+    frame.width = buffer->width();
+    frame.height = buffer->height();
+    frame.y_stride = buffer->StrideY();
+    frame.u_stride = buffer->StrideU();
+    frame.v_stride = buffer->StrideV();
+    frame.y_buffer = (void*)buffer->DataY();
+    frame.u_buffer = (void*)buffer->DataU();
+    frame.v_buffer = (void*)buffer->DataV();
+    frame.frame_handle = buffer.get();
+    frame.render_time_ms = ts;
+    callback(ts, code, &frame);
+}
+
+}	// namespace dii_media_kit
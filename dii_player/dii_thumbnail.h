@@ -0,0 +1,100 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_THUMBNAIL_H__
+#define __DII_THUMBNAIL_H__
+
+#include "dii_common.h"
+#include "webrtc/common_video/include/video_frame_buffer.h"
+
+#include <list>
+#include <string>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+namespace dii_media_kit {
+
+/* Timeline preview extractor, independent of any playing stream.
+ * Every task opens its own demux/decode context and decodes keyframes only,
+ * tasks run on a small worker pool, results are kept in a LRU cache.
+ */
+class DiiThumbnailExtractor {
+private:
+    DiiThumbnailExtractor();
+    static std::mutex ins_mtx_;
+    static std::shared_ptr<DiiThumbnailExtractor> thumbnail_ins_;
+    DiiThumbnailExtractor(const DiiThumbnailExtractor&);
+    DiiThumbnailExtractor& operator= (const DiiThumbnailExtractor&);
+
+public:
+    virtual ~DiiThumbnailExtractor();
+    static std::shared_ptr<DiiThumbnailExtractor> GetInstance();
+
+    // cached thumbnails are called back before return, others on worker thread.
+    int32_t GetThumbnails(const char* url,
+                          const int64_t* timestamps,
+                          int32_t count,
+                          int32_t width,
+                          int32_t height,
+                          DiiThumbnailCallback callback);
+
+private:
+    struct Task {
+        std::string             url;
+        std::vector<int64_t>    timestamps;     // ms, ascending
+        int32_t                 width;
+        int32_t                 height;
+        DiiThumbnailCallback    callback;
+    };
+
+    // keyframe decoded for [keyframe_ts, covered_ts], ms
+    struct CacheEntry {
+        std::string url;
+        int32_t     width;
+        int32_t     height;
+        int64_t     keyframe_ts;
+        int64_t     covered_ts;
+        dii_rtc::scoped_refptr<I420Buffer> buffer;
+    };
+
+    void WorkerLoop();
+    void RunTask(Task& task);
+    dii_rtc::scoped_refptr<I420Buffer> LookupCache(const std::string& url, int64_t ts, int32_t width, int32_t height);
+    void InsertCache(const std::string& url, int64_t ts, int64_t keyframe_ts, int32_t width, int32_t height,
+                     const dii_rtc::scoped_refptr<I420Buffer>& buffer);
+    static void Deliver(const DiiThumbnailCallback& callback, int64_t ts, int32_t code,
+                        const dii_rtc::scoped_refptr<I420Buffer>& buffer);
+
+private:
+    std::mutex                  task_mtx_;
+    std::condition_variable     task_cond_;
+    std::list<Task>             tasks_;
+    std::vector<std::thread*>   workers_;
+    bool                        running_ = false;
+
+    std::mutex                  cache_mtx_;
+    std::list<CacheEntry>       cache_;         // front is the most recent
+    int64_t                     cache_bytes_ = 0;
+};
+
+}	// namespace dii_media_kit
+
+#endif	// __DII_THUMBNAIL_H__
@@ -0,0 +1,271 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_timer_wheel.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
+
+#include <vector>
+
+#define WHEEL_MSG_TICK          4000
+
+// statistics tickers are aligned to 1s
+#define WHEEL_TICKER_INTERVAL   1000
+
+namespace dii_media_kit {
+std::shared_ptr<DiiTimerWheel> DiiTimerWheel::timer_wheel_ins_ = nullptr;
+std::mutex DiiTimerWheel::ins_mtx_;
+std::shared_ptr<DiiTimerWheel> DiiTimerWheel::GetInstance() {
+    std::unique_lock<std::mutex> lck(ins_mtx_);
+    if (timer_wheel_ins_.get() == nullptr) {
+        timer_wheel_ins_.reset(new DiiTimerWheel());
+    }
+    return timer_wheel_ins_;
+}
+
+DiiTimerWheel::DiiTimerWheel() {
+    start_ms_ = dii_rtc::TimeMillis();
+    dii_rtc::Thread::Start();
+}
+
+DiiTimerWheel::~DiiTimerWheel() {
+    dii_rtc::Thread::Clear(this, WHEEL_MSG_TICK);
+    dii_rtc::Thread::Stop();
+}
+
+int64_t DiiTimerWheel::NowTick() {
+    return (dii_rtc::TimeMillis() - start_ms_) / kTickMs;
+}
+
+int64_t DiiTimerWheel::Schedule(int64_t delay_ms, TimerTask task) {
+    if (!task) {
+        return 0;
+    }
+    if (delay_ms < 0) {
+        delay_ms = 0;
+    }
+
+    std::unique_lock<std::mutex> lck(wheel_mtx_);
+    uint64_t expire = NowTick() + (delay_ms + kTickMs - 1) / kTickMs;
+    int64_t id = AddTimerLocked(expire, task);
+    // wake up wheel thread to recalculate next timeout.
+    dii_rtc::Thread::Post(RTC_FROM_HERE, this, WHEEL_MSG_TICK);
+    return id;
+}
+
+void DiiTimerWheel::Cancel(int64_t timer_id) {
+    if (timer_id <= 0) {
+        return;
+    }
+    std::unique_lock<std::mutex> lck(wheel_mtx_);
+    auto it = timers_.find(timer_id);
+    if (it != timers_.end()) {
+        it->second.list->erase(it->second.it);
+        timers_.erase(it);
+        return;
+    }
+
+    // task is running, wait it finish, unless cancel by itself.
+    while (running_id_ == timer_id && !dii_rtc::Thread::IsCurrent()) {
+        wheel_cond_.wait(lck);
+    }
+}
+
+int32_t DiiTimerWheel::AddTicker(void* owner, TimerTask tick) {
+    if (!owner || !tick) {
+        return -1;
+    }
+    std::unique_lock<std::mutex> lck(wheel_mtx_);
+    tickers_[owner] = tick;
+    if (ticker_timer_id_ == 0) {
+        uint64_t interval = WHEEL_TICKER_INTERVAL / kTickMs;
+        uint64_t expire = (NowTick() / interval + 1) * interval;
+        ticker_timer_id_ = AddTimerLocked(expire, [this]() { this->RunTickers(); });
+        dii_rtc::Thread::Post(RTC_FROM_HERE, this, WHEEL_MSG_TICK);
+    }
+    return 0;
+}
+
+void DiiTimerWheel::RemoveTicker(void* owner) {
+    std::unique_lock<std::mutex> lck(wheel_mtx_);
+    tickers_.erase(owner);
+    while (ticking_ && !dii_rtc::Thread::IsCurrent()) {
+        wheel_cond_.wait(lck);
+    }
+}
+
+void DiiTimerWheel::OnMessage(dii_rtc::Message* msg) {
+    switch (msg->message_id) {
+        case WHEEL_MSG_TICK:
+            this->Advance();
+            this->Rearm();
+            break;
+        default:
+            break;
+    }
+}
+
+int64_t DiiTimerWheel::AddTimerLocked(uint64_t expire, TimerTask task) {
+    TimerList tmp;
+    TimerNode node;
+    node.id = ++timer_id_;
+    node.expire = expire;
+    node.task = task;
+    tmp.push_back(node);
+    PlaceTimerLocked(tmp, tmp.begin());
+    return node.id;
+}
+
+void DiiTimerWheel::PlaceTimerLocked(TimerList& from, TimerList::iterator it) {
+    if (it->expire < current_tick_) {
+        it->expire = current_tick_;
+    }
+
+    uint64_t idx = it->expire - current_tick_;
+    TimerList* to = nullptr;
+    if (idx < kRootSize) {
+        to = &root_[it->expire & (kRootSize - 1)];
+    } else if (idx < (1ULL << (kRootBits + kLevelBits))) {
+        to = &levels_[0][(it->expire >> kRootBits) & (kLevelSize - 1)];
+    } else {
+        uint64_t max_idx = (1ULL << (kRootBits + 2 * kLevelBits)) - 1;
+        if (idx > max_idx) {
+            it->expire = current_tick_ + max_idx;
+        }
+        to = &levels_[1][(it->expire >> (kRootBits + kLevelBits)) & (kLevelSize - 1)];
+    }
+
+    // splice keep iterator valid.
+    to->splice(to->end(), from, it);
+    TimerRef ref;
+    ref.list = to;
+    ref.it = it;
+    timers_[it->id] = ref;
+}
+
+void DiiTimerWheel::CascadeLocked(int level, int index) {
+    TimerList tmp;
+    tmp.splice(tmp.end(), levels_[level - 1][index]);
+    while (!tmp.empty()) {
+        PlaceTimerLocked(tmp, tmp.begin());
+    }
+}
+
+void DiiTimerWheel::Advance() {
+    TimerList expired;
+    {
+        std::unique_lock<std::mutex> lck(wheel_mtx_);
+        uint64_t target = NowTick();
+        while (current_tick_ <= target) {
+            int index = current_tick_ & (kRootSize - 1);
+            if (index == 0) {
+                int idx1 = (current_tick_ >> kRootBits) & (kLevelSize - 1);
+                CascadeLocked(1, idx1);
+                if (idx1 == 0) {
+                    CascadeLocked(2, (current_tick_ >> (kRootBits + kLevelBits)) & (kLevelSize - 1));
+                }
+            }
+            for (auto& node : root_[index]) {
+                timers_[node.id].list = &expired;
+            }
+            expired.splice(expired.end(), root_[index]);
+            current_tick_++;
+        }
+    }
+
+    // run one by one, cancel may remove the rest of expired timers.
+    while (true) {
+        TimerTask task;
+        {
+            std::unique_lock<std::mutex> lck(wheel_mtx_);
+            if (expired.empty()) {
+                break;
+            }
+            running_id_ = expired.front().id;
+            task = expired.front().task;
+            timers_.erase(running_id_);
+            expired.pop_front();
+        }
+
+        task();
+
+        std::unique_lock<std::mutex> lck(wheel_mtx_);
+        running_id_ = 0;
+        wheel_cond_.notify_all();
+    }
+}
+
+void DiiTimerWheel::Rearm() {
+    std::unique_lock<std::mutex> lck(wheel_mtx_);
+    dii_rtc::Thread::Clear(this, WHEEL_MSG_TICK);
+    if (timers_.empty()) {
+        return;
+    }
+
+    // sleep until the nearest non-empty slot, or next cascade point.
+    uint64_t wake_tick = (current_tick_ | (kRootSize - 1)) + 1;
+    for (uint64_t tick = current_tick_; tick < wake_tick; tick++) {
+        if (!root_[tick & (kRootSize - 1)].empty()) {
+            wake_tick = tick;
+            break;
+        }
+    }
+
+    int64_t delay_ms = start_ms_ + (int64_t)wake_tick * kTickMs - dii_rtc::TimeMillis();
+    if (delay_ms < 0) {
+        delay_ms = 0;
+    }
+    dii_rtc::Thread::PostDelayed(RTC_FROM_HERE, (int)delay_ms, this, WHEEL_MSG_TICK);
+}
+
+void DiiTimerWheel::RunTickers() {
+    std::vector<void*> owners;
+    {
+        std::unique_lock<std::mutex> lck(wheel_mtx_);
+        ticking_ = true;
+        for (auto& it : tickers_) {
+            owners.push_back(it.first);
+        }
+    }
+
+    for (auto owner : owners) {
+        TimerTask tick;
+        {
+            std::unique_lock<std::mutex> lck(wheel_mtx_);
+            auto it = tickers_.find(owner);
+            if (it == tickers_.end()) {
+                continue;
+            }
+            tick = it->second;
+        }
+        tick();
+    }
+
+    std::unique_lock<std::mutex> lck(wheel_mtx_);
+    ticking_ = false;
+    wheel_cond_.notify_all();
+    if (tickers_.empty()) {
+        ticker_timer_id_ = 0;
+        return;
+    }
+    uint64_t interval = WHEEL_TICKER_INTERVAL / kTickMs;
+    uint64_t expire = (NowTick() / interval + 1) * interval;
+    ticker_timer_id_ = AddTimerLocked(expire, [this]() { this->RunTickers(); });
+}
+
+}	// namespace dii_media_kit
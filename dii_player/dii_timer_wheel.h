@@ -0,0 +1,112 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_TIMER_WHEEL_H__
+#define __DII_TIMER_WHEEL_H__
+
+#include "webrtc/base/thread.h"
+#include "webrtc/base/messagehandler.h"
+
+#include <map>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+namespace dii_media_kit {
+
+/* Process-wide hierarchical timer wheel (10ms tick, 256/64/64 slots).
+ * All players share one thread, the thread only wakes up for the nearest
+ * non-empty slot, and every 1s ticker is run in a single coalesced pass.
+ */
+class DiiTimerWheel : public dii_rtc::Thread,
+                      public dii_rtc::MessageHandler {
+public:
+    typedef std::function<void()> TimerTask;
+
+private:
+    DiiTimerWheel();
+    static std::mutex ins_mtx_;
+    static std::shared_ptr<DiiTimerWheel> timer_wheel_ins_;
+    DiiTimerWheel(const DiiTimerWheel&);
+    DiiTimerWheel& operator= (const DiiTimerWheel&);
+
+public:
+    virtual ~DiiTimerWheel();
+    static std::shared_ptr<DiiTimerWheel> GetInstance();
+
+    // one shot timer, return timer id (> 0), task run on timer wheel thread.
+    int64_t Schedule(int64_t delay_ms, TimerTask task);
+    // after return, task is removed and not running, ids <= 0 are ignored.
+    void Cancel(int64_t timer_id);
+
+    // 1s ticker, all tickers are called one by one in the same pass.
+    int32_t AddTicker(void* owner, TimerTask tick);
+    // after return, tick of owner is removed and not running.
+    void RemoveTicker(void* owner);
+
+    // Handles messages from posts.
+    void OnMessage(dii_rtc::Message* msg) override;
+
+private:
+    struct TimerNode {
+        int64_t   id;
+        uint64_t  expire;   // in tick
+        TimerTask task;
+    };
+    typedef std::list<TimerNode> TimerList;
+    struct TimerRef {
+        TimerList* list;
+        TimerList::iterator it;
+    };
+
+    int64_t AddTimerLocked(uint64_t expire, TimerTask task);
+    void PlaceTimerLocked(TimerList& from, TimerList::iterator it);
+    void CascadeLocked(int level, int index);
+    void Advance();
+    void Rearm();
+    void RunTickers();
+    int64_t NowTick();
+
+private:
+    static const int kTickMs     = 10;
+    static const int kRootBits   = 8;
+    static const int kLevelBits  = 6;
+    static const int kRootSize   = 1 << kRootBits;
+    static const int kLevelSize  = 1 << kLevelBits;
+    static const int kLevels     = 3;
+
+    std::mutex                    wheel_mtx_;
+    std::condition_variable       wheel_cond_;
+    TimerList                     root_[kRootSize];
+    TimerList                     levels_[kLevels - 1][kLevelSize];
+    std::map<int64_t, TimerRef>   timers_;
+    int64_t                       timer_id_ = 0;
+    int64_t                       running_id_ = 0;
+    int64_t                       start_ms_ = 0;
+    uint64_t                      current_tick_ = 0;
+
+    std::map<void*, TimerTask>    tickers_;
+    int64_t                       ticker_timer_id_ = 0;
+    bool                          ticking_ = false;
+};
+
+}	// namespace dii_media_kit
+
+#endif	// __DII_TIMER_WHEEL_H__
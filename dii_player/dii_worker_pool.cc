@@ -0,0 +1,131 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_worker_pool.h"
+#include "webrtc/base/logging.h"
+
+#define WORKER_POOL_MAX_THREADS     4
+
+namespace dii_media_kit {
+
+std::shared_ptr<DiiWorkerPool> DiiWorkerPool::worker_pool_ins_ = nullptr;
+std::mutex DiiWorkerPool::ins_mtx_;
+std::shared_ptr<DiiWorkerPool> DiiWorkerPool::GetInstance() {
+    std::unique_lock<std::mutex> lck(ins_mtx_);
+    if (worker_pool_ins_.get() == nullptr) {
+        worker_pool_ins_.reset(new DiiWorkerPool());
+    }
+    return worker_pool_ins_;
+}
+
+DiiWorkerPool::DiiWorkerPool() {
+    // leave one core for decoder / caller
+    int32_t threads = (int32_t)std::thread::hardware_concurrency() - 1;
+    if (threads > WORKER_POOL_MAX_THREADS) {
+        threads = WORKER_POOL_MAX_THREADS;
+    }
+    running_ = true;
+    for (int32_t i = 0; i < threads; i++) {
+        workers_.push_back(new std::thread(&DiiWorkerPool::WorkerLoop, this));
+    }
+    LOG(LS_INFO) << "worker pool threads: " << workers_.size();
+}
+
+DiiWorkerPool::~DiiWorkerPool() {
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        running_ = false;
+        job_cond_.notify_all();
+    }
+    for (auto it : workers_) {
+        if (it->joinable()) {
+            it->join();
+        }
+        delete it;
+    }
+    workers_.clear();
+}
+
+int32_t DiiWorkerPool::Concurrency() {
+    return (int32_t)workers_.size() + 1;
+}
+
+void DiiWorkerPool::ParallelFor(int32_t count, const Task& task) {
+    if (count <= 0) {
+        return;
+    }
+    if (count == 1 || workers_.empty()) {
+        for (int32_t i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    Job job;
+    job.task = &task;
+    job.count = count;
+    job.next = 0;
+    job.done = 0;
+    job.users = 1;
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        jobs_.push_back(&job);
+        job_cond_.notify_all();
+    }
+    RunJob(&job);
+
+    // job lives on this stack, wait until no worker refers to it.
+    std::unique_lock<std::mutex> lck(mtx_);
+    done_cond_.wait(lck, [&job] { return job.done == job.count && job.users == 0; });
+}
+
+void DiiWorkerPool::RunJob(Job* job) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    while (job->next < job->count) {
+        int32_t index = job->next++;
+        if (job->next == job->count) {
+            jobs_.remove(job);
+        }
+        lck.unlock();
+        (*job->task)(index);
+        lck.lock();
+        job->done++;
+    }
+    job->users--;
+    if (job->done == job->count && job->users == 0) {
+        done_cond_.notify_all();
+    }
+}
+
+void DiiWorkerPool::WorkerLoop() {
+    for (;;) {
+        Job* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lck(mtx_);
+            job_cond_.wait(lck, [this] { return !running_ || !jobs_.empty(); });
+            if (!running_) {
+                return;
+            }
+            job = jobs_.front();
+            job->users++;
+        }
+        RunJob(job);
+    }
+}
+
+}	// namespace dii_media_kit
@@ -0,0 +1,80 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_WORKER_POOL_H__
+#define __DII_WORKER_POOL_H__
+
+#include <stdint.h>
+#include <list>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+namespace dii_media_kit {
+
+/* Process-wide worker threads for splitting one heavy job (e.g. converting a
+ * large frame by row bands) into parts, shared by all players. The caller
+ * thread runs parts as well, so a busy pool never blocks the job.
+ */
+class DiiWorkerPool {
+public:
+    typedef std::function<void(int32_t index)> Task;
+
+private:
+    DiiWorkerPool();
+    static std::mutex ins_mtx_;
+    static std::shared_ptr<DiiWorkerPool> worker_pool_ins_;
+    DiiWorkerPool(const DiiWorkerPool&);
+    DiiWorkerPool& operator= (const DiiWorkerPool&);
+
+public:
+    virtual ~DiiWorkerPool();
+    static std::shared_ptr<DiiWorkerPool> GetInstance();
+
+    // threads may run one job at the same time, workers and caller.
+    int32_t Concurrency();
+    // run task(0) ... task(count - 1), return after all of them are done.
+    void ParallelFor(int32_t count, const Task& task);
+
+private:
+    struct Job {
+        const Task* task;
+        int32_t     count;
+        int32_t     next;       // next index to run
+        int32_t     done;
+        int32_t     users;      // workers still touching this job
+    };
+
+    void WorkerLoop();
+    void RunJob(Job* job);
+
+private:
+    std::mutex                  mtx_;
+    std::condition_variable     job_cond_;
+    std::condition_variable     done_cond_;
+    std::list<Job*>             jobs_;
+    std::vector<std::thread*>   workers_;
+    bool                        running_ = false;
+};
+
+}	// namespace dii_media_kit
+
+#endif	// __DII_WORKER_POOL_H__
@@ -0,0 +1,385 @@
+/*
+ *  Copyright (c) 2013 The devzhaoyou@dii_media project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "headless_renderer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <sstream>
+
+#include "third_party/libyuv/include/libyuv.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
+
+#define DII_HEADLESS_Y4M_DEFAULT_FPS      30
+#define DII_HEADLESS_SHM_DEFAULT_SLOTS    4
+#define DII_HEADLESS_SHM_MAX_SLOTS        64
+#define DII_HEADLESS_REPORT_DEFAULT_S     10
+#define DII_HEADLESS_ALIGN(x)             (((x) + 63) & ~((size_t)63))
+
+namespace dii_media_kit {
+
+#if defined(WEBRTC_LINUX) && !defined(WEBRTC_ANDROID)
+VideoRenderer* VideoRenderer::CreatePlatformRenderer(const void* hwnd,
+                                                     size_t width,
+                                                     size_t height) {
+  return HeadlessRenderer::Create(static_cast<const char*>(hwnd), width,
+                                  height);
+}
+#endif
+
+VideoRenderer* HeadlessRenderer::Create(const char* handle, size_t width,
+                                        size_t height) {
+  if (handle == NULL) {
+    return NULL;
+  }
+  std::string uri(handle);
+  size_t colon = uri.find(':');
+  if (colon == std::string::npos) {
+    LOG(LS_WARNING) << "invalid headless renderer handle: " << uri;
+    return NULL;
+  }
+  std::string scheme = uri.substr(0, colon);
+  std::string target = uri.substr(colon + 1);
+  std::string query;
+  size_t mark = target.find('?');
+  if (mark != std::string::npos) {
+    query = target.substr(mark + 1);
+    target = target.substr(0, mark);
+  }
+
+  if (scheme == "y4m") {
+    return Y4mRenderer::Create(
+        target, ParseOption(query, "fps", DII_HEADLESS_Y4M_DEFAULT_FPS, 1, 240));
+  } else if (scheme == "shm") {
+    return ShmRingRenderer::Create(
+        target, ParseOption(query, "slots", DII_HEADLESS_SHM_DEFAULT_SLOTS, 2,
+                            DII_HEADLESS_SHM_MAX_SLOTS));
+  } else if (scheme == "null") {
+    return new NullStatsRenderer(
+        ParseOption(query, "report", DII_HEADLESS_REPORT_DEFAULT_S, 1, 3600));
+  }
+  LOG(LS_WARNING) << "unknown headless renderer: " << scheme;
+  return NULL;
+}
+
+dii_rtc::scoped_refptr<VideoFrameBuffer> HeadlessRenderer::ToI420(
+    const cricket::VideoFrame& frame) {
+  dii_rtc::scoped_refptr<VideoFrameBuffer> buffer = frame.video_frame_buffer();
+  if (buffer && buffer->native_handle() != NULL) {
+    buffer = buffer->NativeToI420Buffer();
+  }
+  return buffer;
+}
+
+int HeadlessRenderer::ParseOption(const std::string& query, const char* key,
+                                  int default_value, int min_value,
+                                  int max_value) {
+  std::string item;
+  std::istringstream ss(query);
+  size_t key_len = strlen(key);
+  while (std::getline(ss, item, '&')) {
+    if (item.size() > key_len && item.compare(0, key_len, key) == 0 &&
+        item[key_len] == '=') {
+      int value = atoi(item.c_str() + key_len + 1);
+      if (value < min_value || value > max_value) {
+        LOG(LS_WARNING) << "headless renderer option " << key << "=" << value
+                        << " out of range, use " << default_value;
+        return default_value;
+      }
+      return value;
+    }
+  }
+  return default_value;
+}
+
+// Y4mRenderer
+Y4mRenderer* Y4mRenderer::Create(const std::string& path, int fps) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == NULL) {
+    LOG(LS_ERROR) << "can not open y4m file: " << path;
+    return NULL;
+  }
+  LOG(LS_INFO) << "y4m renderer: " << path << ", fps: " << fps;
+  return new Y4mRenderer(file, fps);
+}
+
+Y4mRenderer::Y4mRenderer(FILE* file, int fps)
+    : file_(file),
+      fps_(fps),
+      width_(0),
+      height_(0),
+      frames_(0),
+      dropped_frames_(0) {}
+
+Y4mRenderer::~Y4mRenderer() {
+  fclose(file_);
+  LOG(LS_INFO) << "y4m renderer closed, frames: " << frames_
+               << ", dropped: " << dropped_frames_;
+}
+
+void Y4mRenderer::OnFrame(const cricket::VideoFrame& frame) {
+  dii_rtc::scoped_refptr<VideoFrameBuffer> buffer = ToI420(frame);
+  if (!buffer) {
+    return;
+  }
+  int width = buffer->width();
+  int height = buffer->height();
+
+  // a y4m stream has one resolution, frames of other sizes are dropped.
+  if (frames_ == 0) {
+    width_ = width;
+    height_ = height;
+    fprintf(file_, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width_,
+            height_, fps_);
+  } else if (width != width_ || height != height_) {
+    if (dropped_frames_++ == 0) {
+      LOG(LS_WARNING) << "y4m renderer: resolution changed to " << width
+                      << "x" << height << ", drop frames.";
+    }
+    return;
+  }
+
+  int chroma_width = (width + 1) / 2;
+  int chroma_height = (height + 1) / 2;
+  fputs("FRAME\n", file_);
+  for (int i = 0; i < height; i++) {
+    fwrite(buffer->DataY() + i * buffer->StrideY(), 1, width, file_);
+  }
+  for (int i = 0; i < chroma_height; i++) {
+    fwrite(buffer->DataU() + i * buffer->StrideU(), 1, chroma_width, file_);
+  }
+  for (int i = 0; i < chroma_height; i++) {
+    fwrite(buffer->DataV() + i * buffer->StrideV(), 1, chroma_width, file_);
+  }
+  frames_++;
+}
+
+// ShmRingRenderer
+ShmRingRenderer* ShmRingRenderer::Create(const std::string& name, int slots) {
+  if (name.empty() || name[0] != '/') {
+    LOG(LS_ERROR) << "shm ring name must start with '/': " << name;
+    return NULL;
+  }
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    LOG(LS_ERROR) << "shm_open failed: " << name << ", errno: " << errno;
+    return NULL;
+  }
+  // drop what a previous producer left behind.
+  if (ftruncate(fd, 0) != 0) {
+    LOG(LS_ERROR) << "ftruncate failed: " << name << ", errno: " << errno;
+    close(fd);
+    return NULL;
+  }
+  LOG(LS_INFO) << "shm ring renderer: " << name << ", slots: " << slots;
+  return new ShmRingRenderer(name, fd, slots);
+}
+
+ShmRingRenderer::ShmRingRenderer(const std::string& name, int fd, int slots)
+    : name_(name),
+      fd_(fd),
+      slot_count_(slots),
+      base_(NULL),
+      map_size_(0),
+      header_(NULL) {}
+
+ShmRingRenderer::~ShmRingRenderer() {
+  Unmap();
+  close(fd_);
+  shm_unlink(name_.c_str());
+}
+
+void ShmRingRenderer::Unmap() {
+  if (base_ != NULL) {
+    munmap(base_, map_size_);
+    base_ = NULL;
+    header_ = NULL;
+    map_size_ = 0;
+  }
+}
+
+bool ShmRingRenderer::Configure(int width, int height) {
+  size_t chroma = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+  size_t header_size = DII_HEADLESS_ALIGN(sizeof(ShmRingHeader));
+  size_t slot_size = DII_HEADLESS_ALIGN(sizeof(ShmSlotHeader) +
+                                        (size_t)width * height + chroma * 2);
+  size_t map_size = header_size + slot_size * slot_count_;
+
+  // config_seq and write_seq survive the remap, they live in the file.
+  if (header_ != NULL) {
+    header_->config_seq.fetch_add(1, std::memory_order_acq_rel);
+  }
+  Unmap();
+  if (ftruncate(fd_, map_size) != 0) {
+    LOG(LS_ERROR) << "ftruncate failed: " << name_ << ", errno: " << errno;
+    return false;
+  }
+  void* base = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (base == MAP_FAILED) {
+    LOG(LS_ERROR) << "mmap failed: " << name_ << ", errno: " << errno;
+    return false;
+  }
+  base_ = static_cast<uint8_t*>(base);
+  map_size_ = map_size;
+  header_ = reinterpret_cast<ShmRingHeader*>(base_);
+
+  if ((header_->config_seq.load(std::memory_order_relaxed) & 1) == 0) {
+    header_->config_seq.fetch_add(1, std::memory_order_acq_rel);
+  }
+  header_->magic = DII_SHM_RING_MAGIC;
+  header_->version = DII_SHM_RING_VERSION;
+  header_->width = width;
+  header_->height = height;
+  header_->slot_count = slot_count_;
+  header_->slot_size = slot_size;
+  header_->header_size = header_size;
+  for (uint32_t i = 0; i < slot_count_; i++) {
+    ShmSlotHeader* slot =
+        reinterpret_cast<ShmSlotHeader*>(base_ + header_size + i * slot_size);
+    slot->seq.store(0, std::memory_order_relaxed);
+  }
+  header_->config_seq.fetch_add(1, std::memory_order_release);
+
+  LOG(LS_INFO) << "shm ring " << name_ << " configured: " << width << "x"
+               << height << ", slot size: " << slot_size;
+  return true;
+}
+
+void ShmRingRenderer::OnFrame(const cricket::VideoFrame& frame) {
+  dii_rtc::scoped_refptr<VideoFrameBuffer> buffer = ToI420(frame);
+  if (!buffer) {
+    return;
+  }
+  int width = buffer->width();
+  int height = buffer->height();
+  if (header_ == NULL || header_->width != (uint32_t)width ||
+      header_->height != (uint32_t)height) {
+    if (!Configure(width, height)) {
+      return;
+    }
+  }
+
+  uint64_t index = header_->write_seq.load(std::memory_order_relaxed);
+  uint8_t* slot_base = base_ + header_->header_size +
+                       (index % slot_count_) * header_->slot_size;
+  ShmSlotHeader* slot = reinterpret_cast<ShmSlotHeader*>(slot_base);
+  uint8_t* dst_y = slot_base + sizeof(ShmSlotHeader);
+  uint8_t* dst_u = dst_y + width * height;
+  uint8_t* dst_v = dst_u + ((width + 1) / 2) * ((height + 1) / 2);
+
+  uint32_t seq = slot->seq.load(std::memory_order_relaxed);
+  slot->seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot->frame_index = index;
+  slot->timestamp_us = frame.timestamp_us();
+  dii_libyuv::I420Copy(buffer->DataY(), buffer->StrideY(),
+                       buffer->DataU(), buffer->StrideU(),
+                       buffer->DataV(), buffer->StrideV(),
+                       dst_y, width,
+                       dst_u, (width + 1) / 2,
+                       dst_v, (width + 1) / 2,
+                       width, height);
+  slot->seq.store(seq + 2, std::memory_order_release);
+  header_->write_seq.store(index + 1, std::memory_order_release);
+}
+
+// NullStatsRenderer
+NullStatsRenderer::NullStatsRenderer(int report_interval_s)
+    : report_interval_us_(report_interval_s * dii_rtc::kNumMicrosecsPerSec),
+      last_report_us_(0),
+      last_frame_us_(0),
+      last_interval_us_(-1) {
+  Reset();
+}
+
+NullStatsRenderer::~NullStatsRenderer() {
+  Report();
+}
+
+void NullStatsRenderer::Reset() {
+  frames_ = 0;
+  intervals_ = 0;
+  jitters_ = 0;
+  interval_sum_us_ = 0;
+  interval_max_us_ = 0;
+  jitter_sum_us_ = 0;
+  jitter_max_us_ = 0;
+  memset(interval_hist_, 0, sizeof(interval_hist_));
+  memset(jitter_hist_, 0, sizeof(jitter_hist_));
+}
+
+void NullStatsRenderer::OnFrame(const cricket::VideoFrame& frame) {
+  int64_t now = dii_rtc::TimeMicros();
+  if (last_report_us_ == 0) {
+    last_report_us_ = now;
+  }
+  if (last_frame_us_ != 0) {
+    int64_t interval = now - last_frame_us_;
+    int bucket = (int)(interval / (kBucketMs * 1000));
+    interval_hist_[bucket < kBuckets ? bucket : kBuckets - 1]++;
+    intervals_++;
+    interval_sum_us_ += interval;
+    if (interval > interval_max_us_) {
+      interval_max_us_ = interval;
+    }
+    if (last_interval_us_ >= 0) {
+      int64_t jitter = interval > last_interval_us_
+                           ? interval - last_interval_us_
+                           : last_interval_us_ - interval;
+      bucket = (int)(jitter / (kBucketMs * 1000));
+      jitter_hist_[bucket < kBuckets ? bucket : kBuckets - 1]++;
+      jitters_++;
+      jitter_sum_us_ += jitter;
+      if (jitter > jitter_max_us_) {
+        jitter_max_us_ = jitter;
+      }
+    }
+    last_interval_us_ = interval;
+  }
+  last_frame_us_ = now;
+  frames_++;
+
+  if (now - last_report_us_ >= report_interval_us_) {
+    Report();
+    last_report_us_ = now;
+  }
+}
+
+void NullStatsRenderer::Report() {
+  if (intervals_ == 0) {
+    return;
+  }
+  std::ostringstream interval_hist, jitter_hist;
+  for (int i = 0; i < kBuckets; i++) {
+    if (interval_hist_[i]) {
+      interval_hist << " " << i * kBucketMs << ":" << interval_hist_[i];
+    }
+    if (jitter_hist_[i]) {
+      jitter_hist << " " << i * kBucketMs << ":" << jitter_hist_[i];
+    }
+  }
+  LOG(LS_INFO) << "null renderer frames: " << frames_
+               << ", interval avg: " << interval_sum_us_ / intervals_
+               << "us, max: " << interval_max_us_
+               << "us, jitter avg: " << (jitters_ ? jitter_sum_us_ / jitters_ : 0)
+               << "us, max: " << jitter_max_us_ << "us";
+  LOG(LS_INFO) << "null renderer interval histogram (ms:count):"
+               << interval_hist.str();
+  LOG(LS_INFO) << "null renderer jitter histogram (ms:count):"
+               << jitter_hist.str();
+  Reset();
+}
+}  // namespace dii_media_kit
@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2013 The devzhaoyou@dii_media project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef WEBRTC_TEST_LINUX_HEADLESS_RENDERER_H_
+#define WEBRTC_TEST_LINUX_HEADLESS_RENDERER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <string>
+
+#include "video_renderer.h"
+#include "webrtc/common_video/include/video_frame_buffer.h"
+
+namespace dii_media_kit {
+
+// Headless sinks for Linux, selected by the handle passed as hwnd, a C string:
+//   "y4m:/path/out.y4m[?fps=N]"  write every frame to a YUV4MPEG2 file.
+//   "shm:/name[?slots=N]"        publish I420 frames to a POSIX shm ring.
+//   "null:[?report=N]"           discard frames, log frame interval
+//                                histograms every N seconds.
+class HeadlessRenderer : public VideoRenderer {
+ public:
+  static VideoRenderer* Create(const char* handle, size_t width,
+                               size_t height);
+  virtual ~HeadlessRenderer() {}
+
+ protected:
+  // frame as a readable I420 buffer, NULL for unsupported native frames.
+  static dii_rtc::scoped_refptr<VideoFrameBuffer> ToI420(
+      const cricket::VideoFrame& frame);
+  static int ParseOption(const std::string& query, const char* key,
+                         int default_value, int min_value, int max_value);
+};
+
+class Y4mRenderer : public HeadlessRenderer {
+ public:
+  static Y4mRenderer* Create(const std::string& path, int fps);
+  ~Y4mRenderer() override;
+
+  void OnFrame(const cricket::VideoFrame& frame) override;
+
+ private:
+  Y4mRenderer(FILE* file, int fps);
+
+  FILE* file_;
+  int fps_;
+  int width_, height_;
+  int64_t frames_;
+  int64_t dropped_frames_;
+};
+
+// Shared memory layout, all fields native endian:
+//   ShmRingHeader | slot 0 | slot 1 | ... | slot (slot_count - 1)
+// each slot is ShmSlotHeader followed by the Y, U and V planes, tightly
+// packed. Producer is wait free, consumers never block it: a slot is
+// guarded by a seqlock (odd while written), a reader copies the planes and
+// retries if seq changed meanwhile. write_seq is the number of frames
+// published, the newest frame lives in slot (write_seq - 1) % slot_count.
+// Ring is resized on resolution change, config_seq is odd meanwhile and
+// consumers should remap when it changes.
+#define DII_SHM_RING_MAGIC    0x474e5244      // "DRNG"
+#define DII_SHM_RING_VERSION  1
+
+struct ShmRingHeader {
+  uint32_t magic;
+  uint32_t version;
+  std::atomic<uint32_t> config_seq;
+  uint32_t width;
+  uint32_t height;
+  uint32_t slot_count;
+  uint32_t slot_size;           // bytes, including ShmSlotHeader
+  uint32_t header_size;         // offset of slot 0
+  std::atomic<uint64_t> write_seq;
+};
+
+struct ShmSlotHeader {
+  std::atomic<uint32_t> seq;
+  uint32_t reserved;
+  uint64_t frame_index;         // write_seq when published, minus one
+  int64_t timestamp_us;
+};
+
+class ShmRingRenderer : public HeadlessRenderer {
+ public:
+  static ShmRingRenderer* Create(const std::string& name, int slots);
+  ~ShmRingRenderer() override;
+
+  void OnFrame(const cricket::VideoFrame& frame) override;
+
+ private:
+  ShmRingRenderer(const std::string& name, int fd, int slots);
+
+  bool Configure(int width, int height);
+  void Unmap();
+
+  std::string name_;
+  int fd_;
+  uint32_t slot_count_;
+  uint8_t* base_;
+  size_t map_size_;
+  ShmRingHeader* header_;
+};
+
+class NullStatsRenderer : public HeadlessRenderer {
+ public:
+  explicit NullStatsRenderer(int report_interval_s);
+  ~NullStatsRenderer() override;
+
+  void OnFrame(const cricket::VideoFrame& frame) override;
+
+ private:
+  // 2ms buckets, last one collects everything >= 100ms.
+  enum { kBucketMs = 2, kBuckets = 51 };
+
+  void Report();
+  void Reset();
+
+  int64_t report_interval_us_;
+  int64_t last_report_us_;
+  int64_t last_frame_us_;
+  int64_t last_interval_us_;
+
+  int64_t frames_;
+  int64_t intervals_;
+  int64_t jitters_;
+  int64_t interval_sum_us_;
+  int64_t interval_max_us_;
+  int64_t jitter_sum_us_;
+  int64_t jitter_max_us_;
+  uint32_t interval_hist_[kBuckets];    // frame interval
+  uint32_t jitter_hist_[kBuckets];      // |interval - previous interval|
+};
+}  // namespace dii_media_kit
+
+#endif  // WEBRTC_TEST_LINUX_HEADLESS_RENDERER_H_
@@ -28,6 +28,7 @@ class VideoRenderer : public dii_rtc::VideoSinkInterface<cricket::VideoFrame> {
   // Creates a platform-specific renderer if possible, returns NULL if a
   // platform renderer could not be created. This occurs, for instance, when
   // running without an X environment on Linux.
+  // On desktop Linux hwnd is a sink handle string, see headless_renderer.h.
   static VideoRenderer* CreatePlatformRenderer(const void* hwnd,
                                                size_t width, size_t height);
   virtual ~VideoRenderer() {}
@@ -359,6 +359,8 @@ int32_t H264DecoderImpl::Decode(const EncodedImage& input_image,
   RTC_CHECK_EQ(av_frame_->data[kVPlane],
                video_frame->video_frame_buffer()->DataV());
   video_frame->set_timestamp(input_image._timeStamp);
+  // reordered_opaque follows the frame through reordering, see Decode.
+  video_frame->set_ntp_time_ms(av_frame_->reordered_opaque / 1000);
 
   int32_t ret;
 
@@ -377,6 +379,7 @@ int32_t H264DecoderImpl::Decode(const EncodedImage& input_image,
     VideoFrame cropped_frame(
         cropped_buf, video_frame->timestamp(), video_frame->render_time_ms(),
         video_frame->rotation());
+    cropped_frame.set_ntp_time_ms(video_frame->ntp_time_ms());
     // TODO(nisse): Timestamp and rotation are all zero here. Change decoder
     // interface to pass a VideoFrameBuffer instead of a VideoFrame?
     ret = decoded_image_callback_->Decoded(cropped_frame);